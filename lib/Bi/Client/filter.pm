@@ -148,7 +148,46 @@ C<metropolis>.
 
 =item C<-C> (default 0)
 
-Number of steps to take.
+Number of steps to take. With C<--metropolis-bias>, the maximum number of
+steps to take, zero for no maximum.
+
+=item C<--metropolis-bias> (default 0.0)
+
+Bound on the bias of the resampler, used to choose the number of steps
+adaptively at each resampling step, from the ratio of the maximum to the
+mean weight. Zero to always take C<-C> steps. The filter command reports the
+mean and maximum number of steps chosen.
+
+=back
+
+=head2 Particle number tuning options
+
+These options tune C<--nparticles> for use with particle marginal
+Metropolis-Hastings (C<libbi sample --sampler mh>). Instead of filtering
+once, the filter is run repeatedly at the parameter given by
+C<--init-file>, with the number of particles doubling from C<--nparticles>,
+until the standard deviation of the log-likelihood estimate falls below one.
+The number of particles that minimises the computation time per effective
+sample (Pitt et al. 2012), typically giving a standard deviation near 1.5, is
+then recommended. Progress and the recommendation are reported on stderr;
+nothing is written to C<--output-file>. Not supported with C<--filter kalman>
+or C<--filter adaptive>.
+
+=over 4
+
+=item C<--tune-nparticles> (default 0)
+
+Tune the number of particles rather than filter.
+
+=item C<--tune-replicates> (default 32)
+
+Number of runs of the filter for each number of particles. These run in
+parallel, one per thread. Must be at least 2, to estimate the standard
+deviation.
+
+=item C<--tune-max-nparticles> (default 32768)
+
+Maximum number of particles to try.
 
 =back
 
@@ -216,6 +255,13 @@ criterion.
 
 Number of particles per block.
 
+=item C<--with-speculation> (default 0)
+
+Propagate several blocks of particles at once, as many as were needed at the
+previous observation, to keep all threads busy. The stopping criterion is
+still applied block by block, and any surplus blocks are discarded, so that
+results are distributed as without speculation.
+
 =back
 
 =cut
@@ -265,6 +311,26 @@ our @CLIENT_OPTIONS = (
       type => 'int',
       default => 0
     },
+    {
+      name => 'metropolis-bias',
+      type => 'float',
+      default => 0.0
+    },
+    {
+      name => 'tune-nparticles',
+      type => 'bool',
+      default => 0
+    },
+    {
+      name => 'tune-replicates',
+      type => 'int',
+      default => 32
+    },
+    {
+      name => 'tune-max-nparticles',
+      type => 'int',
+      default => 32768
+    },
     {
       name => 'nbridges',
       type => 'int',
@@ -290,6 +356,11 @@ our @CLIENT_OPTIONS = (
       type => 'int',
       default => 32768
     },
+    {
+      name => 'with-speculation',
+      type => 'bool',
+      default => 0
+    },
     
     # deprecations
     {
@@ -359,6 +430,14 @@ sub process_args {
     if ($filter eq 'kalman') {
         $self->set_named_arg('with-transform-extended', 1);
     }
+    if ($self->get_named_arg('tune-nparticles')) {
+        if ($filter eq 'kalman' || $filter eq 'adaptive') {
+            die("--tune-nparticles is not supported with --filter $filter\n");
+        }
+        if ($self->get_named_arg('tune-replicates') < 2) {
+            die("--tune-replicates must be at least 2\n");
+        }
+    }
     $self->{_binary} = 'filter';
 }
 
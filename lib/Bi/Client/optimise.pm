@@ -55,12 +55,47 @@ The optimisation method to use; one of:
 
 Nelder-Mead simplex method.
 
+=item C<crn>
+
+Nelder-Mead simplex method with common random numbers. The random number
+generator is reseeded identically before every evaluation of the objective,
+so that the likelihood estimate of a particle filter becomes a deterministic
+function of the parameters. This avoids the simplex chasing Monte Carlo
+noise, and permits far fewer particles, but optimises for one realisation of
+that noise.
+
 =back
 
+=item C<--nstarts> (default 1)
+
+Number of starting points, at least one. When greater than one, the
+optimiser is run from this many starting points in parallel, one per thread,
+and the best result reported. The first starting point is that given by
+C<--init-file>, if any, the remainder are drawn from the prior. Values
+greater than one are not supported with C<--filter adaptive>.
+
+=item C<--memo-file> (default none)
+
+File in which to keep a cache of evaluations of the objective between runs.
+Evaluations are cached whenever they are deterministic, that is with
+C<--filter kalman> or C<--optimiser crn>, and otherwise not. The file is
+read at the start of the run, if it exists, and written at the end. It is
+ignored if written for a different model, filter, number of particles, time
+interval or observation file. With C<--optimiser crn>, the common random
+numbers are seeded from C<--seed>, so cached evaluations are only reused
+between runs given the same C<--seed>.
+
+=item C<--memo-resolution> (default 1.0e-8)
+
+Resolution to which parameters are rounded when looking up cached
+evaluations.
+
 =back
 
 =head2 Nelder-mead simplex method-specific options
 
+These apply to both C<nm> and C<crn>.
+
 =over 4
 
 =item C<--simplex-size-real> (default 0.1)
@@ -99,6 +134,21 @@ our @CLIENT_OPTIONS = (
       type => 'string',
       default => 'likelihood'
     },
+    {
+      name => 'nstarts',
+      type => 'int',
+      default => 1
+    },
+    {
+      name => 'memo-file',
+      type => 'string',
+      default => ''
+    },
+    {
+      name => 'memo-resolution',
+      type => 'float',
+      default => 1.0e-8
+    },
     {
       name => 'simplex-size-rel',
       type => 'float',
@@ -127,6 +177,13 @@ sub process_args {
     my $self = shift;
 
     $self->Bi::Client::filter::process_args(@_);   
+    my $nstarts = $self->get_named_arg('nstarts');
+    if ($nstarts < 1) {
+        die("--nstarts must be at least 1\n");
+    }
+    if ($self->get_named_arg('filter') eq 'adaptive' && $nstarts > 1) {
+        die("--nstarts greater than one is not supported with --filter adaptive\n");
+    }
     $self->{_binary} = 'optimise';
 }
 
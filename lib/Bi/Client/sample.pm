@@ -77,6 +77,10 @@ Marginal sequential importance resampling (Chopin, Jacob & Papaspiliopoulos, 201
 
 Marginal sequential importance sampling (SIS).
 
+=item C<pt>
+
+Marginal Metropolis-Hastings with parallel tempering, see below.
+
 =back
 
 For MH, the proposal works according to the L<proposal_parameter> top-level
@@ -90,6 +94,8 @@ L<initial> top-level block instead.
 For SIR, the same blocks are used as proposals for rejuvenation steps,
 unless one of the adaptation strategies below is enabled.
 
+For PT, the same blocks are used as for MH.
+
 =item C<--nsamples> (default 1)
 
 Number of samples to draw.
@@ -111,6 +117,13 @@ If positive, C<--nmoves> and C<--sample-ess-rel> are ignored. Resampling is
 performed after each step, and the number of moves subsequently made becomes
 a random variable dependent on C<--tmoves>.
 
+=item C<--exchange-rate> (default 0.0)
+
+Acceptance rate of move steps below which to double the number of state
+particles, C<--nparticles>, for all parameter particles (Chopin et al. 2013).
+Zero never to do so. Not supported with C<--filter adaptive>, which chooses
+its own number of particles.
+
 =item C<--sample-resampler> (default C<systematic>)
 
 The type of resampler to use on parameter particles, see C<--resampler> for
@@ -154,12 +167,46 @@ Local proposal adaptation.
 
 Global proposal adaptation.
 
+=item C<kernel>
+
+Independent proposals from a weighted kernel density estimate over the
+parameter samples. This is better suited to multimodal posteriors than the
+single Gaussian of C<global>.
+
+=item C<mixture>
+
+Independent proposals from a mixture of Gaussians fitted to the weighted
+parameter samples by expectation-maximisation. See
+C<--adapter-components>.
+
 =back
 
-=item C<--adapter-scale> (default 0.25)
+For C<--sampler mh> and C<--sampler pt>, C<local> enables online adaptive
+Metropolis proposals: a Gaussian random walk with covariance given by the
+running covariance of the chain, updated at each step, plus a small multiple
+of the identity. Until the chain has more than twice as many states as there
+are parameters, the C<proposal_parameter> top-level block is used instead.
+Only C<none> and C<local> are supported for these samplers.
+
+For C<--sampler smc2> with a Gaussian proposal, that is other than
+C<kernel> or C<mixture>, the proposal is updated in place when few
+parameter samples have changed since the last adaptation, and refitted
+otherwise. The number of each is reported at the end of sampling.
+
+=item C<--adapter-scale> (default 0.25, or 1 for C<--sampler mh> and C<--sampler pt>)
 
 When local proposal adaptation is used, the scaling factor of the local
 proposal standard deviation relative to the global sample standard deviation.
+When kernel proposal adaptation is used, the scaling factor of the kernel
+bandwidth relative to the rule-of-thumb bandwidth. For C<--sampler mh>, the
+scaling factor of the random walk standard deviation relative to the optimal
+2.38/sqrt(d) scaling for d parameters.
+
+=item C<--adapter-components> (default 0)
+
+When mixture proposal adaptation is used, the number of mixture components.
+If zero, the number of components is selected by the Bayesian information
+criterion, up to a maximum of five.
 
 =item C<--adapter-ess-rel> (default 0.25)
 
@@ -171,6 +218,77 @@ instead.
 
 =back
 
+=head2 SIS-specific options
+
+=over 4
+
+=item C<--nbatch> (default 1)
+
+Number of proposals to draw at once, at least one. The proposals of a batch
+are filtered in parallel, one per thread, then output in order. The proposal
+is adapted after each batch, to all weighted samples so far. Not supported
+with C<--filter adaptive> for values greater than one.
+
+=back
+
+=head2 PT-specific options
+
+Several marginal Metropolis-Hastings chains are run in parallel, one per
+thread, each with its log-likelihood tempered by an inverse temperature.
+These are spaced geometrically from one, for the chain that targets the
+posterior, to the reciprocal of C<--max-temperature>. Neighbouring chains
+periodically propose to swap their states. Only the chain that targets the
+posterior is output, and only it uses C<--adapter local>, if given. Not
+supported with C<--filter adaptive>.
+
+=over 4
+
+=item C<--ntemperatures> (default 4)
+
+Number of temperatures, and so of chains. Must be at least 1.
+
+=item C<--max-temperature> (default 10.0)
+
+Maximum temperature. Must be at least 1.
+
+=item C<--swap-interval> (default 1)
+
+Number of steps between swap moves. Must be at least 1.
+
+=back
+
+=head2 Checkpointing options
+
+For C<--sampler mh> and C<--sampler sir>, long runs may be checkpointed
+periodically, and resumed from the last checkpoint after interruption. The
+resumed run continues exactly as the uninterrupted run would have, provided
+that it uses the same options and number of threads, and, for SIR, that
+C<--tmoves> is zero. Checkpoints are written in the background, so that
+sampling continues while they are written, except with CUDA or MPI, where
+sampling waits for each to be written. Checkpointing is not supported with
+other samplers, including C<--sampler pt>, and these options are then an
+error.
+
+=over 4
+
+=item C<--checkpoint-file> (default none)
+
+File to which to write checkpoints. With MPI, the rank of the process is
+appended to the file name, as for C<--output-file>.
+
+=item C<--checkpoint-interval> (default 0)
+
+Number of samples (for MH) or observations (for SIR) between checkpoints.
+Zero for no checkpoints.
+
+=item C<--resume> (default 0)
+
+Resume from the checkpoint in C<--checkpoint-file>, if it exists. For MH,
+samples are appended to the existing C<--output-file>. Otherwise a new run is
+started.
+
+=back
+
 =cut
 our @CLIENT_OPTIONS = (
     {
@@ -208,6 +326,31 @@ our @CLIENT_OPTIONS = (
       type => 'float',
       default => 0.0
     },
+    {
+      name => 'exchange-rate',
+      type => 'float',
+      default => 0.0
+    },
+    {
+      name => 'nbatch',
+      type => 'int',
+      default => 1
+    },
+    {
+      name => 'ntemperatures',
+      type => 'int',
+      default => 4
+    },
+    {
+      name => 'max-temperature',
+      type => 'float',
+      default => 10.0
+    },
+    {
+      name => 'swap-interval',
+      type => 'int',
+      default => 1
+    },
     {
       name => 'sample-resampler',
       type => 'string',
@@ -248,6 +391,26 @@ our @CLIENT_OPTIONS = (
       type => 'float',
       default => 0.25
     },
+    {
+      name => 'adapter-components',
+      type => 'int',
+      default => 0
+    },
+    {
+      name => 'checkpoint-file',
+      type => 'string',
+      default => ''
+    },
+    {
+      name => 'checkpoint-interval',
+      type => 'int',
+      default => 0
+    },
+    {
+      name => 'resume',
+      type => 'bool',
+      default => 0
+    },
 );
 
 sub init {
@@ -282,6 +445,43 @@ sub process_args {
 	    	$self->set_named_arg('sampler', 'sir'); # standardise name
     	}
     }
+    if ($sampler eq 'mh' || $sampler eq 'pt') {
+        my $adapter = $self->get_named_arg('adapter');
+        if ($adapter ne 'none' && $adapter ne 'local') {
+            die("--adapter $adapter is not supported with --sampler $sampler, use --adapter local\n");
+        }
+        if (!$self->is_named_arg('adapter-scale')) {
+            $self->set_named_arg('adapter-scale', 1.0);
+        }
+    }
+    if ($sampler eq 'pt') {
+        if ($filter eq 'adaptive') {
+            die("--sampler pt is not supported with --filter adaptive\n");
+        }
+        if ($self->get_named_arg('ntemperatures') < 1) {
+            die("--ntemperatures must be at least 1\n");
+        }
+        if ($self->get_named_arg('max-temperature') < 1.0) {
+            die("--max-temperature must be at least 1\n");
+        }
+        if ($self->get_named_arg('swap-interval') < 1) {
+            die("--swap-interval must be at least 1\n");
+        }
+    }
+    if ($self->get_named_arg('nbatch') < 1) {
+        die("--nbatch must be at least 1\n");
+    }
+    if ($filter eq 'adaptive' && $self->get_named_arg('nbatch') > 1) {
+        die("--nbatch greater than one is not supported with --filter adaptive\n");
+    }
+    if ($filter eq 'adaptive' && $self->get_named_arg('exchange-rate') > 0.0) {
+        die("--exchange-rate is not supported with --filter adaptive\n");
+    }
+    $sampler = $self->get_named_arg('sampler');
+    if ($sampler ne 'mh' && $sampler ne 'sir' &&
+        ($self->get_named_arg('checkpoint-file') ne '' || $self->get_named_arg('resume'))) {
+        die("--checkpoint-file and --resume are not supported with --sampler $sampler\n");
+    }
     
     $self->{_binary} = 'sample';
 }
@@ -6,6 +6,25 @@ test_resampler - test resamplers.
 
     libbi test_resampler ...
 
+    mpirun -np 4 libbi test_resampler ...
+
+=head1 DESCRIPTION
+
+Benchmarks a resampler over a range of weight vector parameterisations and
+sizes. For each trial, the time taken by each phase of resampling is written
+to the output file, in microseconds: C<time_reduce> for the ESS reduction,
+C<time_precompute>, C<time_offspring>, C<time_ancestors>, C<time_permute>,
+and C<time_gather> for copying C<--nvars> variables of each particle from its
+ancestor, as well as the C<time> of the whole. These have a leading
+C<threads> dimension, see C<--with-thread-scaling>. The squared bias
+C<bias2> and the trace of the variance C<tr_var> of the offspring are also
+written, along with C<tr_var_rel>, the latter relative to the variance of
+multinomial resampling.
+
+With MPI, each process runs the benchmark with its own output file, the rank
+of the process appended to C<--output-file>. The ESS reduction is then that
+of the distributed resampler, and so collective across processes.
+
 =head1 INHERITS
 
 L<Bi::Client>
@@ -36,6 +55,12 @@ for a stratified (systematic) resampler (Kitagawa 1996),
 
 for a multinomial resampler,
 
+=item C<'multinomial-search'>
+
+for a multinomial resampler by binary search of the cumulative weights, the
+baseline against which to compare C<'multinomial'>, which generates sorted
+variates to merge with the cumulative weights in linear time,
+
 =item C<'metropolis'>
 
 for a Metropolis resampler (Murray 2011),
@@ -73,6 +98,16 @@ resampling on CPU when copying weight vectors from GPU.
 
 Divisor under the default number of steps in the Metropolis resampler.
 
+=item C<--nvars> (default 8)
+
+Number of variables per particle to copy from ancestors.
+
+=item C<--with-thread-scaling> (default off)
+
+Repeat each trial with the number of threads doubling from one up to
+C<--nthreads>, rather than only with C<--nthreads>. Ignored with
+C<--with-cuda>.
+
 =back
 
 =cut
@@ -116,6 +151,16 @@ our @CLIENT_OPTIONS = (
       name => 'C',
       type => 'int',
       default => 1
+    },
+    {
+      name => 'nvars',
+      type => 'int',
+      default => 8
+    },
+    {
+      name => 'with-thread-scaling',
+      type => 'bool',
+      default => 0
     }
 );
 
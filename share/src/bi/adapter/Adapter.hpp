@@ -6,6 +6,8 @@
 #ifndef BI_ADAPTER_ADAPTER_HPP
 #define BI_ADAPTER_ADAPTER_HPP
 
+#include "../misc/macro.hpp"
+
 namespace bi {
 /**
  * Adapter.
@@ -15,19 +17,8 @@ namespace bi {
 template<class A>
 class Adapter: public A {
 public:
-  /**
-   * Constructor.
-   */
-  Adapter(const bool local = false, const double scale = 0.25,
-      const double essRel = 0.25);
+  BI_PASSTHROUGH_CONSTRUCTORS(Adapter, A)
 };
 }
 
-template<class A>
-bi::Adapter<A>::Adapter(const bool local, const double scale,
-    const double essRel) :
-    A(local, scale, essRel) {
-  //
-}
-
 #endif
@@ -10,3 +10,21 @@ boost::shared_ptr<bi::Adapter<bi::GaussianAdapter> > bi::AdapterFactory::createG
   return boost::make_shared < Adapter<GaussianAdapter>
       > (local, scale, essRel);
 }
+
+boost::shared_ptr<bi::Adapter<bi::KernelAdapter> > bi::AdapterFactory::createKernelAdapter(
+    const bool local, const double scale, const double essRel) {
+  return boost::make_shared < Adapter<KernelAdapter>
+      > (local, scale, essRel);
+}
+
+boost::shared_ptr<bi::Adapter<bi::MixtureAdapter> > bi::AdapterFactory::createMixtureAdapter(
+    const bool local, const double scale, const double essRel, const int K) {
+  return boost::make_shared < Adapter<MixtureAdapter>
+      > (local, scale, essRel, K);
+}
+
+boost::shared_ptr<bi::Adapter<bi::AdaptiveMetropolisAdapter> > bi::AdapterFactory::createAdaptiveMetropolisAdapter(
+    const bool local, const double scale, const double essRel) {
+  return boost::make_shared < Adapter<AdaptiveMetropolisAdapter>
+      > (local, scale, essRel);
+}
@@ -8,6 +8,9 @@
 
 #include "Adapter.hpp"
 #include "GaussianAdapter.hpp"
+#include "KernelAdapter.hpp"
+#include "AdaptiveMetropolisAdapter.hpp"
+#include "MixtureAdapter.hpp"
 
 #include "boost/shared_ptr.hpp"
 #include "boost/make_shared.hpp"
@@ -26,6 +29,27 @@ public:
   static boost::shared_ptr<Adapter<GaussianAdapter> > createGaussianAdapter(
       const bool local = false, const double scale = 0.25,
       const double essRel = 0.5);
+
+  /**
+   * Create kernel density adapter.
+   */
+  static boost::shared_ptr<Adapter<KernelAdapter> > createKernelAdapter(
+      const bool local = false, const double scale = 1.0,
+      const double essRel = 0.5);
+
+  /**
+   * Create Gaussian mixture adapter.
+   */
+  static boost::shared_ptr<Adapter<MixtureAdapter> > createMixtureAdapter(
+      const bool local = false, const double scale = 1.0,
+      const double essRel = 0.5, const int K = 0);
+
+  /**
+   * Create adaptive Metropolis adapter.
+   */
+  static boost::shared_ptr<Adapter<AdaptiveMetropolisAdapter> > createAdaptiveMetropolisAdapter(
+      const bool local = true, const double scale = 1.0,
+      const double essRel = 0.5);
 };
 }
 
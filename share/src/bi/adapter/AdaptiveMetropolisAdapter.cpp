@@ -0,0 +1,21 @@
+/**
+ * @file
+ *
+ * @author Lawrence Murray <lawrence.murray@csiro.au>
+ * $Rev$
+ * $Date$
+ */
+#include "AdaptiveMetropolisAdapter.hpp"
+
+bi::AdaptiveMetropolisAdapter::AdaptiveMetropolisAdapter(const bool local,
+    const double scale, const double essRel, const double eps) :
+    detU(0.0), n(0), scale(scale), eps(eps) {
+  //
+}
+
+void bi::AdaptiveMetropolisAdapter::reset() {
+  mu.resize(0);
+  U.resize(0, 0);
+  detU = 0.0;
+  n = 0;
+}
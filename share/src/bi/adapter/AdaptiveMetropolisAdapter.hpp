@@ -0,0 +1,226 @@
+/**
+ * @file
+ *
+ * @author Lawrence Murray <lawrence.murray@csiro.au>
+ * $Rev$
+ * $Date$
+ */
+#ifndef BI_ADAPTER_ADAPTIVEMETROPOLISADAPTER_HPP
+#define BI_ADAPTER_ADAPTIVEMETROPOLISADAPTER_HPP
+
+#include "../random/Random.hpp"
+#include "../misc/exception.hpp"
+#include "../math/vector.hpp"
+#include "../math/matrix.hpp"
+
+#include "boost/serialization/split_member.hpp"
+
+namespace bi {
+/**
+ * Adapter for online adaptive Metropolis proposal.
+ *
+ * @ingroup method_adapter
+ *
+ * Implements the adaptive Metropolis proposal of
+ * @ref Haario2001 "Haario, Saksman \& Tamminen (2001)" for a single chain,
+ * such as that of MarginalMH. Each state of the chain is added with #add,
+ * which updates a running mean and the upper-triangular Cholesky factor of
+ * the running covariance with a single rank-one update (see #ch1up). The
+ * cost of each step is then \f$O(N_\theta^2)\f$, and does not grow with
+ * the length of the chain.
+ *
+ * Proposals are Gaussian random walks with covariance
+ * \f$(2.38s)^2(\Sigma + \epsilon I)/N_\theta\f$, where \f$\Sigma\f$ is the
+ * running covariance, \f$s\f$ the scale and \f$\epsilon\f$ the
+ * regularisation given to the constructor. The regularisation keeps the
+ * proposal nondegenerate should the chain stick in some directions.
+ */
+class AdaptiveMetropolisAdapter {
+public:
+  /**
+   * Constructor.
+   *
+   * @param local Unused, the proposal is always a random walk.
+   * @param scale Scale factor for the standard deviation of proposals,
+   * relative to the optimal scaling of \f$2.38/\sqrt{N_\theta}\f$.
+   * @param essRel Unused, the states of a single chain are unweighted.
+   * @param eps Regularisation of the covariance.
+   */
+  AdaptiveMetropolisAdapter(const bool local = true, const double scale =
+      1.0, const double essRel = 0.25, const double eps = 1.0e-6);
+
+  /**
+   * Add state of the chain.
+   *
+   * @tparam S1 State type.
+   *
+   * @param s1 State.
+   */
+  template<class S1>
+  void add(const S1& s1);
+
+  /**
+   * Is the adapter ready to propose?
+   *
+   * The adapter is ready once more than twice as many states as there are
+   * parameters have been added, and the running covariance is of full rank.
+   */
+  bool ready() const;
+
+  /**
+   * Reset the adapter, discarding all states added so far.
+   */
+  void reset();
+
+  /**
+   * @copydoc GaussianAdapter::propose()
+   */
+  template<class S1, class S2>
+  void propose(Random& rng, S1& s1, S2& s2);
+
+private:
+  /**
+   * Running mean.
+   */
+  host_vector<real> mu;
+
+  /**
+   * Upper-triangular Cholesky factor of running covariance.
+   */
+  host_matrix<real> U;
+
+  /**
+   * Determinant of #U.
+   */
+  real detU;
+
+  /**
+   * Number of states added.
+   */
+  int n;
+
+  /**
+   * Scale of proposals.
+   */
+  double scale;
+
+  /**
+   * Regularisation of covariance.
+   */
+  double eps;
+
+  /**
+   * Serialize.
+   */
+  template<class Archive>
+  void save(Archive& ar, const unsigned version) const;
+
+  /**
+   * Restore from serialization.
+   */
+  template<class Archive>
+  void load(Archive& ar, const unsigned version);
+
+  /*
+   * Boost.Serialization requirements.
+   */
+  BOOST_SERIALIZATION_SPLIT_MEMBER()
+  friend class boost::serialization::access;
+};
+}
+
+#include "../model/Model.hpp"
+#include "../math/constant.hpp"
+#include "../math/scalar.hpp"
+#include "../math/view.hpp"
+#include "../math/operation.hpp"
+#include "../math/temp_vector.hpp"
+#include "../primitive/vector_primitive.hpp"
+#include "../cuda/cuda.hpp"
+
+inline bool bi::AdaptiveMetropolisAdapter::ready() const {
+  return n > 2 * int(mu.size()) && bi::abs(detU) > 0.0;
+}
+
+template<class S1>
+void bi::AdaptiveMetropolisAdapter::add(const S1& s1) {
+  BOOST_AUTO(theta, vec(s1.get(P_VAR)));
+
+  const int N = theta.size();
+  typename temp_host_vector<real>::type x(N), work(N);
+  x = theta;
+  synchronize();
+
+  if (n == 0) {
+    mu.resize(N);
+    U.resize(N, N);
+    mu = x;
+    U.clear();
+  } else {
+    /* deviation from previous mean */
+    axpy(-1.0, mu, x);
+
+    /* mean */
+    axpy(1.0 / (n + 1), x, mu);
+
+    /* covariance, as Cholesky factor, using
+     * \Sigma_{n+1} = n/(n+1) \Sigma_n + n/(n+1)^2 (x - \mu_n)(x - \mu_n)^T */
+    matrix_scal(bi::sqrt(real(n) / (n + 1)), U);
+    scal(bi::sqrt(real(n)) / (n + 1), x);
+    ch1up(U, x, work);
+  }
+  ++n;
+
+  /* determinant */
+  detU = prod_reduce(diagonal(U));
+}
+
+template<class S1, class S2>
+void bi::AdaptiveMetropolisAdapter::propose(Random& rng, S1& s1, S2& s2) {
+  /* pre-condition */
+  BI_ASSERT(ready());
+
+  BOOST_AUTO(theta1, vec(s1.get(P_VAR)));
+  BOOST_AUTO(theta2, vec(s2.get(P_VAR)));
+
+  const int N = theta1.size();
+  const real sd = 2.38 * scale / bi::sqrt(real(N));
+  typename temp_host_vector<real>::type htheta1(N), htheta2(N), z(N);
+  htheta1 = theta1;
+  synchronize();
+
+  /* sum of independent draws with covariances \Sigma and \epsilon I */
+  rng.gaussians(htheta2);
+  rng.gaussians(z);
+  trmv(U, htheta2, 'U', 'T');
+  axpy(bi::sqrt(eps), z, htheta2);
+  axpy(sd, htheta2, htheta1);
+
+  /* symmetric, so cancels in the acceptance ratio */
+  s1.logProposal = 0.0;
+  s2.logProposal = 0.0;
+
+  theta2 = htheta1;
+
+  synchronize();
+}
+
+template<class Archive>
+void bi::AdaptiveMetropolisAdapter::save(Archive& ar,
+    const unsigned version) const {
+  save_resizable_vector(ar, version, mu);
+  save_resizable_matrix(ar, version, U);
+  ar & detU;
+  ar & n;
+}
+
+template<class Archive>
+void bi::AdaptiveMetropolisAdapter::load(Archive& ar,
+    const unsigned version) {
+  load_resizable_vector(ar, version, mu);
+  load_resizable_matrix(ar, version, U);
+  ar & detU;
+  ar & n;
+}
+
+#endif
@@ -7,6 +7,7 @@
 
 bi::GaussianAdapter::GaussianAdapter(const bool local, const double scale,
     const double essRel) :
-    local(local), scale(scale), essRel(essRel) {
+    W(0.0), lwmax(0.0), detU(1.0), local(local), scale(scale), essRel(
+        essRel), nupdates(0), nfits(0) {
   //
 }
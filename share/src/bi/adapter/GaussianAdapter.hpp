@@ -13,11 +13,22 @@
 #include "../math/vector.hpp"
 #include "../math/matrix.hpp"
 
+#include "boost/serialization/split_member.hpp"
+
 namespace bi {
 /**
  * Adapter for Gaussian proposal.
  *
  * @ingroup method_adapter
+ *
+ * Weighted sufficient statistics of the samples are kept between
+ * adaptations. When few samples have been replaced or reweighted since the
+ * last adaptation, these and the Cholesky factor of the covariance are
+ * updated in place with rank-one updates (see #ch1up, #ch1dn), so that the
+ * cost is proportional to the number of changed samples. The statistics
+ * are invariant to a common factor in the weights, so a shift common to
+ * the log-weights of most samples, such as the normalisation of SMC^2
+ * between steps, does not count as a change.
  */
 class GaussianAdapter {
 public:
@@ -42,6 +53,20 @@ public:
   template<class S1>
   bool adapt(const S1& s);
 
+  /**
+   * Adapt the proposal to weighted samples.
+   *
+   * @tparam M1 Matrix type.
+   * @tparam V1 Vector type.
+   *
+   * @param X Samples. Rows index samples, columns index variables.
+   * @param lws Log-weights.
+   *
+   * @return Was the adaptation successful?
+   */
+  template<class M1, class V1>
+  bool adapt(const M1 X, const V1 lws);
+
 #ifdef ENABLE_MPI
   template<class S1>
   bool distributedAdapt(const S1& s);
@@ -62,7 +87,86 @@ public:
   template<class S1, class S2>
   void propose(Random& rng, S1& s1, S2& s2);
 
+  /**
+   * Number of adaptations by update of the sufficient statistics.
+   */
+  int getNumUpdates() const;
+
+  /**
+   * Number of adaptations by recomputation of the sufficient statistics.
+   */
+  int getNumFits() const;
+
 private:
+  /**
+   * Recompute sufficient statistics from all samples.
+   *
+   * @tparam M1 Matrix type.
+   * @tparam V1 Vector type.
+   *
+   * @param X Samples. Rows index samples, columns index variables.
+   * @param lws Log-weights.
+   */
+  template<class M1, class V1>
+  void fit(const M1 X, const V1 lws);
+
+  /**
+   * Update sufficient statistics for changed samples only.
+   *
+   * @tparam M1 Matrix type.
+   * @tparam V1 Vector type.
+   *
+   * @param X Samples. Rows index samples, columns index variables.
+   * @param lws Log-weights.
+   *
+   * @return True if the update was performed, false if so many samples
+   * have changed that recomputation with #fit is cheaper.
+   *
+   * Samples are compared to those of the last call to #fit or #update. The
+   * median shift in the log-weights of samples that have not moved is
+   * taken as a common factor, and absorbed into #lwmax. Each sample that
+   * has moved, or whose log-weight differs from this shift, costs a
+   * rank-one update and downdate of #R.
+   */
+  template<class M1, class V1>
+  bool update(const M1 X, const V1 lws);
+
+  /**
+   * Samples of last adaptation.
+   */
+  host_matrix<real> X0;
+
+  /**
+   * Log-weights of last adaptation.
+   */
+  host_vector<real> lws0;
+
+  /**
+   * Centre of sufficient statistics.
+   */
+  host_vector<real> c;
+
+  /**
+   * Weighted sum of centred samples.
+   */
+  host_vector<real> m;
+
+  /**
+   * Upper-triangular Cholesky factor of weighted sum of outer products of
+   * centred samples.
+   */
+  host_matrix<real> R;
+
+  /**
+   * Sum of weights, relative to #lwmax.
+   */
+  real W;
+
+  /**
+   * Reference log-weight.
+   */
+  real lwmax;
+
   /**
    * Mean.
    */
@@ -97,6 +201,34 @@ private:
    * Minimum relative ESS to be considered ready.
    */
   double essRel;
+
+  /**
+   * Number of adaptations by #update.
+   */
+  int nupdates;
+
+  /**
+   * Number of adaptations by #fit.
+   */
+  int nfits;
+
+  /**
+   * Serialize.
+   */
+  template<class Archive>
+  void save(Archive& ar, const unsigned version) const;
+
+  /**
+   * Restore from serialization.
+   */
+  template<class Archive>
+  void load(Archive& ar, const unsigned version);
+
+  /*
+   * Boost.Serialization requirements.
+   */
+  BOOST_SERIALIZATION_SPLIT_MEMBER()
+  friend class boost::serialization::access;
 };
 }
 
@@ -109,9 +241,13 @@ private:
 #include "../math/temp_matrix.hpp"
 #include "../pdf/misc.hpp"
 #include "../primitive/vector_primitive.hpp"
+#include "../primitive/matrix_primitive.hpp"
 #include "../cuda/cuda.hpp"
 #include "../mpi/mpi.hpp"
 
+#include <vector>
+#include <algorithm>
+
 template<class S1>
 bool bi::GaussianAdapter::adapt(const S1& s) {
   const int NP = s.s1s[0]->get(P_VAR).size2();
@@ -119,27 +255,60 @@ bool bi::GaussianAdapter::adapt(const S1& s) {
 
   bool ready = s.ess >= essRel * P;
   if (ready) {
-    try {
-      typename temp_host_matrix<real>::type X(P, NP);
-      typename temp_host_vector<real>::type ws(P);
+    typename temp_host_matrix<real>::type X(P, NP);
+    typename temp_host_vector<real>::type lws(P);
 
-      /* copy samples into single matrix */
-      for (int p = 0; p < P; ++p) {
-        row(X, p) = vec(s.s1s[p]->get(P_VAR));
+    /* copy samples into single matrix */
+    for (int p = 0; p < P; ++p) {
+      row(X, p) = vec(s.s1s[p]->get(P_VAR));
+    }
+    lws = s.logWeights();
+    synchronize();
+
+    ready = adapt(X, lws);
+  }
+  return ready;
+}
+
+template<class M1, class V1>
+bool bi::GaussianAdapter::adapt(const M1 X, const V1 lws) {
+  const int P = X.size1();
+  const int NP = X.size2();
+
+  bool ready = ess_reduce(lws) >= essRel * P;
+  if (ready) {
+    try {
+      /* update sufficient statistics for changed samples only, falling back
+       * to recomputation when too many have changed, or if a downdate
+       * fails */
+      bool updated = false;
+      if (X0.size1() == P && X0.size2() == NP) {
+        try {
+          updated = update(X, lws);
+        } catch (CholeskyException e) {
+          updated = false;
+        }
+      }
+      if (updated) {
+        ++nupdates;
+      } else {
+        fit(X, lws);
+        ++nfits;
       }
-      expu_elements(s.logWeights(), ws);
 
       /* mean */
       mu.resize(NP);
-      mean(X, ws, mu);
-
-      /* covariance */
-      Sigma.resize(NP, NP);
-      cov(X, ws, mu, Sigma);
+      mu = c;
+      axpy(1.0 / W, m, mu);
 
       /* Cholesky factor of covariance */
+      typename temp_host_vector<real>::type a(NP), work(NP);
+      a = m;
+      scal(1.0 / W, a);
       U.resize(NP, NP);
-      chol(Sigma, U);
+      U = R;
+      matrix_scal(1.0 / bi::sqrt(W), U);
+      ch1dn(U, a, work);
 
       /* scale for local moves */
       if (local) {
@@ -149,12 +318,154 @@ bool bi::GaussianAdapter::adapt(const S1& s) {
       /* determinant */
       detU = prod_reduce(diagonal(U));
     } catch (CholeskyException e) {
+      /* statistics may be inconsistent, recompute next time */
+      X0.resize(0, 0);
       ready = false;
     }
   }
   return ready;
 }
 
+template<class M1, class V1>
+void bi::GaussianAdapter::fit(const M1 X, const V1 lws) {
+  const int P = X.size1();
+  const int NP = X.size2();
+
+  typename temp_host_matrix<real>::type Y(P, NP), Z(P, NP);
+  typename temp_host_vector<real>::type ws(P), vs(P);
+
+  X0.resize(P, NP);
+  lws0.resize(P);
+  X0 = X;
+  lws0 = lws;
+
+  /* weights, relative to largest */
+  lwmax = max_reduce(lws);
+  subscal_elements(lws, lwmax, ws);
+  exp_elements(ws, ws);
+  W = sum_reduce(ws);
+
+  /* centre on mean, so that sum of centred samples is zero */
+  c.resize(NP);
+  m.resize(NP);
+  gemv(1.0 / W, X, ws, 0.0, c, 'T');
+  m.clear();
+
+  /* Cholesky factor of weighted sum of outer products */
+  Y = X;
+  sub_rows(Y, c);
+  sqrt_elements(ws, vs);
+  gdmm(1.0, vs, Y, 0.0, Z);
+  Sigma.resize(NP, NP);
+  syrk(1.0, Z, 0.0, Sigma, 'U', 'T');
+  R.resize(NP, NP);
+  chol(Sigma, R);
+}
+
+template<class M1, class V1>
+bool bi::GaussianAdapter::update(const M1 X, const V1 lws) {
+  const int P = X.size1();
+  const int NP = X.size2();
+
+  /* moved samples, and shifts in the log-weights of the others */
+  std::vector<bool> moved(P);
+  std::vector<real> shifts;
+  int p, j;
+  bool same;
+  for (p = 0; p < P; ++p) {
+    same = true;
+    for (j = 0; same && j < NP; ++j) {
+      same = X(p, j) == X0(p, j);
+    }
+    moved[p] = !same;
+    if (same) {
+      shifts.push_back(lws(p) - lws0(p));
+    }
+  }
+
+  /* a common shift is a common factor in the weights, which is absorbed
+   * into the reference log-weight without changing the statistics */
+  if (shifts.size() > 0) {
+    std::nth_element(shifts.begin(), shifts.begin() + shifts.size() / 2,
+        shifts.end());
+    real shift = shifts[shifts.size() / 2];
+    addscal_elements(lws0, shift, lws0);
+    lwmax += shift;
+  }
+
+  /* changed samples, allowing for round-off in the shift */
+  std::vector<int> changed;
+  real tol;
+  for (p = 0; p < P; ++p) {
+    tol = 1.0e-8 * (1.0 + bi::abs(lws(p)));
+    if (moved[p] || bi::abs(lws(p) - lws0(p)) > tol) {
+      changed.push_back(p);
+    }
+  }
+
+  /* a rank-one update or downdate costs about as much as one sample's
+   * contribution to a full recomputation */
+  if (2 * int(changed.size()) > P) {
+    return false;
+  }
+
+  /* rescale weights relative to new largest, so that none overflow */
+  real lwmax1 = max_reduce(lws);
+  real k = bi::exp(lwmax - lwmax1);
+  W *= k;
+  scal(k, m);
+  matrix_scal(bi::sqrt(k), R);
+  lwmax = lwmax1;
+
+  /* update and downdate for each changed sample */
+  typename temp_host_vector<real>::type y0(NP), y1(NP), a(NP), work(NP);
+  real w0, w1;
+  for (int i = 0; i < int(changed.size()); ++i) {
+    p = changed[i];
+    w0 = bi::exp(lws0(p) - lwmax);
+    w1 = bi::exp(lws(p) - lwmax);
+
+    y0 = row(X0, p);
+    axpy(-1.0, c, y0);
+    y1 = row(X, p);
+    axpy(-1.0, c, y1);
+
+    if (moved[p]) {
+      /* update before downdate, to remain positive definite */
+      a = y1;
+      scal(bi::sqrt(w1), a);
+      ch1up(R, a, work);
+      a = y0;
+      scal(bi::sqrt(w0), a);
+      ch1dn(R, a, work);
+    } else if (w1 > w0) {
+      a = y1;
+      scal(bi::sqrt(w1 - w0), a);
+      ch1up(R, a, work);
+    } else {
+      a = y1;
+      scal(bi::sqrt(w0 - w1), a);
+      ch1dn(R, a, work);
+    }
+    W += w1 - w0;
+    axpy(w1, y1, m);
+    axpy(-w0, y0, m);
+
+    row(X0, p) = row(X, p);
+  }
+  lws0 = lws;
+
+  return true;
+}
+
+inline int bi::GaussianAdapter::getNumUpdates() const {
+  return nupdates;
+}
+
+inline int bi::GaussianAdapter::getNumFits() const {
+  return nfits;
+}
+
 #ifdef ENABLE_MPI
 template<class S1>
 bool bi::GaussianAdapter::distributedAdapt(const S1& s) {
@@ -254,4 +565,28 @@ void bi::GaussianAdapter::propose(Random& rng, S1& s1, S2& s2) {
   synchronize();
 }
 
+template<class Archive>
+void bi::GaussianAdapter::save(Archive& ar,
+    const unsigned version) const {
+  save_resizable_matrix(ar, version, X0);
+  save_resizable_vector(ar, version, lws0);
+  save_resizable_vector(ar, version, c);
+  save_resizable_vector(ar, version, m);
+  save_resizable_matrix(ar, version, R);
+  ar & W;
+  ar & lwmax;
+}
+
+template<class Archive>
+void bi::GaussianAdapter::load(Archive& ar,
+    const unsigned version) {
+  load_resizable_matrix(ar, version, X0);
+  load_resizable_vector(ar, version, lws0);
+  load_resizable_vector(ar, version, c);
+  load_resizable_vector(ar, version, m);
+  load_resizable_matrix(ar, version, R);
+  ar & W;
+  ar & lwmax;
+}
+
 #endif
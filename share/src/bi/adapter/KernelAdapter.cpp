@@ -0,0 +1,14 @@
+/**
+ * @file
+ *
+ * @author Lawrence Murray <lawrence.murray@csiro.au>
+ * $Rev$
+ * $Date$
+ */
+#include "KernelAdapter.hpp"
+
+bi::KernelAdapter::KernelAdapter(const bool local, const double scale,
+    const double essRel) :
+    detU(1.0), h(1.0), scale(scale), essRel(essRel) {
+  BI_ERROR_MSG(!local, "Kernel adapter does not support local proposals");
+}
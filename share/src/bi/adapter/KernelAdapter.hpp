@@ -0,0 +1,361 @@
+/**
+ * @file
+ *
+ * @author Lawrence Murray <lawrence.murray@csiro.au>
+ * $Rev$
+ * $Date$
+ */
+#ifndef BI_ADAPTER_KERNELADAPTER_HPP
+#define BI_ADAPTER_KERNELADAPTER_HPP
+
+#include "../kd/FlatKDTree.hpp"
+#include "../random/Random.hpp"
+#include "../misc/exception.hpp"
+#include "../math/vector.hpp"
+#include "../math/matrix.hpp"
+
+#include "boost/serialization/split_member.hpp"
+#include "boost/shared_ptr.hpp"
+
+namespace bi {
+/**
+ * Adapter for kernel density proposal.
+ *
+ * @ingroup method_adapter
+ *
+ * Fits a weighted kernel density estimate over the \f$\theta\f$-particles,
+ * and uses it as an independent proposal. Samples are first standardised by
+ * their weighted mean and covariance, so that a Gaussian kernel with a
+ * single bandwidth is appropriate. The bandwidth is chosen with #hopt
+ * using the effective sample size. Proposal densities are evaluated with
+ * #singleTreeDensity over a flat \f$kd\f$ tree of the standardised samples,
+ * with zero error tolerance, so that they are exact, as the
+ * Metropolis-Hastings acceptance ratio requires. The tree then only prunes
+ * nodes whose contribution underflows.
+ *
+ * For multimodal posteriors this gives much higher acceptance rates in
+ * move steps than the single Gaussian of GaussianAdapter.
+ */
+class KernelAdapter {
+public:
+  /**
+   * Constructor.
+   *
+   * @param local Must be false, the kernel density proposal is always
+   * independent of the current state.
+   * @param scale Scale factor for the kernel bandwidth, relative to
+   * #hopt.
+   * @param essRel Minimum relative ESS for the adapter to be considered
+   * ready.
+   */
+  KernelAdapter(const bool local = false, const double scale = 1.0,
+      const double essRel = 0.25);
+
+  /**
+   * @copydoc GaussianAdapter::adapt()
+   */
+  template<class S1>
+  bool adapt(const S1& s);
+
+  /**
+   * @copydoc GaussianAdapter::adapt(const M1, const V1)
+   */
+  template<class M1, class V1>
+  bool adapt(const M1 X, const V1 lws);
+
+#ifdef ENABLE_MPI
+  template<class S1>
+  bool distributedAdapt(const S1& s);
+#endif
+
+  /**
+   * @copydoc GaussianAdapter::propose()
+   */
+  template<class S1, class S2>
+  void propose(Random& rng, S1& s1, S2& s2);
+
+private:
+  /**
+   * Fit kernel density estimate.
+   *
+   * @tparam M1 Matrix type.
+   * @tparam V1 Vector type.
+   *
+   * @param X Samples. Rows index samples, columns index variables.
+   * @param lws Log-weights.
+   * @param ess Effective sample size.
+   */
+  template<class M1, class V1>
+  void fit(const M1 X, const V1 lws, const double ess);
+
+  /**
+   * \f$kd\f$ tree over standardised samples.
+   */
+  boost::shared_ptr<FlatKDTree<> > tree;
+
+  /**
+   * Normalised log-weights.
+   */
+  host_vector<real> lws;
+
+  /**
+   * Standardised samples.
+   */
+  host_matrix<real> Z;
+
+  /**
+   * Mean.
+   */
+  host_vector<real> mu;
+
+  /**
+   * Covariance.
+   */
+  host_matrix<real> Sigma;
+
+  /**
+   * Upper-triangular Cholesky factor of #Sigma.
+   */
+  host_matrix<real> U;
+
+  /**
+   * Determinant of #U.
+   */
+  real detU;
+
+  /**
+   * Kernel bandwidth.
+   */
+  real h;
+
+  /**
+   * Scale of kernel bandwidth.
+   */
+  double scale;
+
+  /**
+   * Minimum relative ESS to be considered ready.
+   */
+  double essRel;
+
+  /**
+   * Serialize.
+   */
+  template<class Archive>
+  void save(Archive& ar, const unsigned version) const;
+
+  /**
+   * Restore from serialization. The tree is not saved, but rebuilt from
+   * the standardised samples and their weights.
+   */
+  template<class Archive>
+  void load(Archive& ar, const unsigned version);
+
+  /*
+   * Boost.Serialization requirements.
+   */
+  BOOST_SERIALIZATION_SPLIT_MEMBER()
+  friend class boost::serialization::access;
+};
+}
+
+#include "../kd/kde.hpp"
+#include "../kd/FastGaussianKernel.hpp"
+#include "../model/Model.hpp"
+#include "../math/constant.hpp"
+#include "../math/scalar.hpp"
+#include "../math/view.hpp"
+#include "../math/operation.hpp"
+#include "../math/temp_vector.hpp"
+#include "../math/temp_matrix.hpp"
+#include "../math/serialization.hpp"
+#include "../pdf/misc.hpp"
+#include "../primitive/vector_primitive.hpp"
+#include "../primitive/matrix_primitive.hpp"
+#include "../cuda/cuda.hpp"
+#include "../mpi/mpi.hpp"
+
+template<class S1>
+bool bi::KernelAdapter::adapt(const S1& s) {
+  const int NP = s.s1s[0]->get(P_VAR).size2();
+  const int P = s.size();
+
+  bool ready = s.ess >= essRel * P;
+  if (ready) {
+    try {
+      typename temp_host_matrix<real>::type X(P, NP);
+
+      /* copy samples into single matrix */
+      for (int p = 0; p < P; ++p) {
+        row(X, p) = vec(s.s1s[p]->get(P_VAR));
+      }
+      synchronize();
+
+      fit(X, s.logWeights(), s.ess);
+    } catch (CholeskyException e) {
+      ready = false;
+    }
+  }
+  return ready;
+}
+
+template<class M1, class V1>
+bool bi::KernelAdapter::adapt(const M1 X, const V1 lws) {
+  const int P = X.size1();
+  const double ess = ess_reduce(lws);
+
+  bool ready = ess >= essRel * P;
+  if (ready) {
+    try {
+      fit(X, lws, ess);
+    } catch (CholeskyException e) {
+      ready = false;
+    }
+  }
+  return ready;
+}
+
+#ifdef ENABLE_MPI
+template<class S1>
+bool bi::KernelAdapter::distributedAdapt(const S1& s) {
+  boost::mpi::communicator world;
+  const int size = world.size();
+  const int NP = s.s1s[0]->get(P_VAR).size2();
+  const int P = s.size();
+
+  bool ready = s.ess >= essRel * P * size;
+  if (ready) {
+    try {
+      typename temp_host_matrix<real>::type X(P, NP), Xs(P * NP, size),
+          Y(P * size, NP), lwss(P, size);
+      typename temp_host_vector<real>::type lws(P);
+
+      /* copy samples into single matrix */
+      for (int p = 0; p < P; ++p) {
+        row(X, p) = vec(s.s1s[p]->get(P_VAR));
+      }
+      lws = s.logWeights();
+      synchronize();
+
+      /* kernel density estimate is over all samples, so gather them */
+      boost::mpi::all_gather(world, X.buf(), P * NP, Xs.buf());
+      boost::mpi::all_gather(world, lws.buf(), P, lwss.buf());
+      for (int k = 0; k < size; ++k) {
+        rows(Y, k * P, P) = reshape(columns(Xs, k, 1), P, NP);
+      }
+
+      fit(Y, vec(lwss), s.ess);
+    } catch (CholeskyException e) {
+      ready = false;
+    }
+  }
+  return ready;
+}
+#endif
+
+template<class S1, class S2>
+void bi::KernelAdapter::propose(Random& rng, S1& s1, S2& s2) {
+  BOOST_AUTO(theta1, vec(s1.get(P_VAR)));
+  BOOST_AUTO(theta2, vec(s2.get(P_VAR)));
+
+  const int N = theta1.size();
+  typename temp_host_vector<real>::type z1(N), z2(N);
+  z1 = theta1;
+  synchronize();
+
+  /* draw component, then perturb with kernel, in standardised space */
+  int p = rng.multinomial(lws);
+  rng.gaussians(z2, 0.0, h);
+  axpy(1.0, row(Z, p), z2);
+
+  /* standardise current state */
+  axpy(-1.0, mu, z1);
+  trsv(U, z1, 'U', 'T');
+
+  /* evaluate proposal density at both states, exactly, as an approximate
+   * density would bias the acceptance ratio */
+  FastGaussianKernel K(N, h);
+  real lp1 = singleTreeDensity(z1, *tree, K, 0.0);
+  real lp2 = singleTreeDensity(z2, *tree, K, 0.0);
+
+  /* FastGaussianKernel is normalised in one dimension only, correct for N
+   * dimensions, then for standardisation */
+  real logZ = (N - 1) * (bi::log(h) + BI_HALF_LOG_TWO_PI) + bi::log(detU);
+  s1.logProposal = bi::log(lp1) - logZ;
+  s2.logProposal = bi::log(lp2) - logZ;
+
+  /* proposed state */
+  trmv(U, z2, 'U', 'T');
+  axpy(1.0, mu, z2);
+  theta2 = z2;
+
+  synchronize();
+}
+
+template<class M1, class V1>
+void bi::KernelAdapter::fit(const M1 X, const V1 lws, const double ess) {
+  const int P = X.size1();
+  const int N = X.size2();
+
+  typename temp_host_vector<real>::type ws(P);
+
+  /* normalised weights */
+  this->lws.resize(P);
+  this->lws = lws;
+  synchronize();
+  subscal_elements(this->lws, logsumexp_reduce(this->lws), this->lws);
+  exp_elements(this->lws, ws);
+
+  /* mean */
+  mu.resize(N);
+  mean(X, ws, mu);
+
+  /* covariance */
+  Sigma.resize(N, N);
+  cov(X, ws, mu, Sigma);
+
+  /* Cholesky factor of covariance */
+  U.resize(N, N);
+  chol(Sigma, U);
+  detU = prod_reduce(diagonal(U));
+
+  /* standardised samples */
+  Z.resize(P, N);
+  Z = X;
+  sub_rows(Z, mu);
+  trsm(1.0, U, Z, 'R', 'U');
+
+  /* bandwidth and tree */
+  h = scale * hopt(N, bi::max(1, int(ess)));
+  tree.reset(new FlatKDTree<>(Z, this->lws));
+}
+
+template<class Archive>
+void bi::KernelAdapter::save(Archive& ar, const unsigned version) const {
+  save_resizable_vector(ar, version, lws);
+  save_resizable_matrix(ar, version, Z);
+  save_resizable_vector(ar, version, mu);
+  save_resizable_matrix(ar, version, Sigma);
+  save_resizable_matrix(ar, version, U);
+  ar & detU;
+  ar & h;
+}
+
+template<class Archive>
+void bi::KernelAdapter::load(Archive& ar, const unsigned version) {
+  load_resizable_vector(ar, version, lws);
+  load_resizable_matrix(ar, version, Z);
+  load_resizable_vector(ar, version, mu);
+  load_resizable_matrix(ar, version, Sigma);
+  load_resizable_matrix(ar, version, U);
+  ar & detU;
+  ar & h;
+
+  if (Z.size1() > 0) {
+    tree.reset(new FlatKDTree<>(Z, lws));
+  } else {
+    tree.reset();
+  }
+}
+
+#endif
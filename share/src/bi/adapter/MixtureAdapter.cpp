@@ -0,0 +1,14 @@
+/**
+ * @file
+ *
+ * @author Lawrence Murray <lawrence.murray@csiro.au>
+ * $Rev$
+ * $Date$
+ */
+#include "MixtureAdapter.hpp"
+
+bi::MixtureAdapter::MixtureAdapter(const bool local, const double scale,
+    const double essRel, const int K) :
+    ridge(0.0), K(K), essRel(essRel) {
+  //
+}
@@ -0,0 +1,570 @@
+/**
+ * @file
+ *
+ * @author Lawrence Murray <lawrence.murray@csiro.au>
+ * $Rev$
+ * $Date$
+ */
+#ifndef BI_ADAPTER_MIXTUREADAPTER_HPP
+#define BI_ADAPTER_MIXTUREADAPTER_HPP
+
+#include "../random/Random.hpp"
+#include "../misc/exception.hpp"
+#include "../math/vector.hpp"
+#include "../math/matrix.hpp"
+
+#include "boost/serialization/access.hpp"
+
+namespace bi {
+/**
+ * Adapter for Gaussian mixture proposal.
+ *
+ * @ingroup method_adapter
+ *
+ * Fits a mixture of Gaussians to the weighted \f$\theta\f$-particles by
+ * expectation-maximisation (EM), and uses it as an independent proposal.
+ * The E-step is parallel over samples, the M-step uses #syrk and #chol for
+ * each component. The number of components is either fixed, or selected by
+ * the Bayesian information criterion (BIC), using the effective sample size
+ * in place of the number of samples.
+ *
+ * EM is initialised deterministically: components are centred on samples
+ * chosen greedily to be far apart, in weighted Mahalanobis distance, and all
+ * take the covariance of the samples.
+ *
+ * For multimodal or strongly non-Gaussian posteriors this gives higher
+ * acceptance rates in move steps than the single Gaussian of
+ * GaussianAdapter.
+ */
+class MixtureAdapter {
+public:
+  /**
+   * Constructor.
+   *
+   * @param local Unused, the mixture proposal is always independent of the
+   * current state.
+   * @param scale Unused.
+   * @param essRel Minimum relative ESS for the adapter to be considered
+   * ready.
+   * @param K Number of components. If zero, the number of components is
+   * selected by BIC, up to #MAX_COMPONENTS.
+   */
+  MixtureAdapter(const bool local = false, const double scale = 1.0,
+      const double essRel = 0.25, const int K = 0);
+
+  /**
+   * @copydoc GaussianAdapter::adapt()
+   */
+  template<class S1>
+  bool adapt(const S1& s);
+
+  /**
+   * @copydoc GaussianAdapter::adapt(const M1, const V1)
+   */
+  template<class M1, class V1>
+  bool adapt(const M1 X, const V1 lws);
+
+#ifdef ENABLE_MPI
+  template<class S1>
+  bool distributedAdapt(const S1& s);
+#endif
+
+  /**
+   * @copydoc GaussianAdapter::propose()
+   */
+  template<class S1, class S2>
+  void propose(Random& rng, S1& s1, S2& s2);
+
+  /**
+   * Maximum number of components when selecting by BIC.
+   */
+  static const int MAX_COMPONENTS = 5;
+
+  /**
+   * Maximum number of EM iterations.
+   */
+  static const int MAX_ITERATIONS = 100;
+
+private:
+  /**
+   * Fit mixture.
+   *
+   * @tparam M1 Matrix type.
+   * @tparam V1 Vector type.
+   *
+   * @param X Samples. Rows index samples, columns index variables.
+   * @param lws Log-weights.
+   * @param ess Effective sample size.
+   */
+  template<class M1, class V1>
+  void fit(const M1 X, const V1 lws, const double ess);
+
+  /**
+   * Fit mixture with given number of components by EM.
+   *
+   * @tparam M1 Matrix type.
+   * @tparam V1 Vector type.
+   * @tparam M2 Matrix type.
+   * @tparam M3 Matrix type.
+   * @tparam V2 Vector type.
+   * @tparam V3 Vector type.
+   *
+   * @param X Samples. Rows index samples, columns index variables.
+   * @param ws Normalised weights.
+   * @param K Number of components.
+   * @param[out] Mu Means. Rows index components.
+   * @param[out] Us Upper-triangular Cholesky factors of covariances,
+   * concatenated column-wise.
+   * @param[out] lpis Log-mixing proportions.
+   * @param[out] ldetUs Log-determinants of Cholesky factors.
+   *
+   * @return Weighted mean log-likelihood of the samples.
+   */
+  template<class M1, class V1, class M2, class M3, class V2, class V3>
+  real em(const M1 X, const V1 ws, const int K, M2& Mu, M3& Us, V2& lpis,
+      V3& ldetUs);
+
+  /**
+   * E-step.
+   *
+   * @tparam M1 Matrix type.
+   * @tparam V1 Vector type.
+   * @tparam M2 Matrix type.
+   * @tparam M3 Matrix type.
+   * @tparam V2 Vector type.
+   * @tparam V3 Vector type.
+   * @tparam M4 Matrix type.
+   *
+   * @param X Samples.
+   * @param ws Normalised weights.
+   * @param Mu Means.
+   * @param Us Cholesky factors.
+   * @param lpis Log-mixing proportions.
+   * @param ldetUs Log-determinants of Cholesky factors.
+   * @param[out] Rs Responsibilities. Rows index components, columns index
+   * samples.
+   *
+   * @return Weighted mean log-likelihood of the samples.
+   */
+  template<class M1, class V1, class M2, class M3, class V2, class V3,
+      class M4>
+  real estep(const M1 X, const V1 ws, const M2 Mu, const M3 Us,
+      const V2 lpis, const V3 ldetUs, M4 Rs);
+
+  /**
+   * M-step.
+   *
+   * @tparam M1 Matrix type.
+   * @tparam V1 Vector type.
+   * @tparam M2 Matrix type.
+   * @tparam M3 Matrix type.
+   * @tparam M4 Matrix type.
+   * @tparam V2 Vector type.
+   * @tparam V3 Vector type.
+   *
+   * @param X Samples.
+   * @param ws Normalised weights.
+   * @param Rs Responsibilities.
+   * @param[out] Mu Means.
+   * @param[out] Us Cholesky factors.
+   * @param[out] lpis Log-mixing proportions.
+   * @param[out] ldetUs Log-determinants of Cholesky factors.
+   */
+  template<class M1, class V1, class M2, class M3, class M4, class V2,
+      class V3>
+  void mstep(const M1 X, const V1 ws, const M2 Rs, M3 Mu, M4 Us, V2 lpis,
+      V3 ldetUs);
+
+  /**
+   * Log-density of mixture.
+   *
+   * @tparam V1 Vector type.
+   *
+   * @param x Point.
+   *
+   * @return Log-density of mixture at @p x.
+   */
+  template<class V1>
+  real logDensity(const V1 x);
+
+  /**
+   * Means. Rows index components.
+   */
+  host_matrix<real> Mu;
+
+  /**
+   * Upper-triangular Cholesky factors of covariances, concatenated
+   * column-wise.
+   */
+  host_matrix<real> Us;
+
+  /**
+   * Log-mixing proportions.
+   */
+  host_vector<real> lpis;
+
+  /**
+   * Log-determinants of #Us.
+   */
+  host_vector<real> ldetUs;
+
+  /**
+   * Ridge added to covariances, relative to mean sample variance.
+   */
+  real ridge;
+
+  /**
+   * Number of components, zero to select by BIC.
+   */
+  int K;
+
+  /**
+   * Minimum relative ESS to be considered ready.
+   */
+  double essRel;
+
+  /**
+   * Serialize. The proposal is refitted from scratch on each call to
+   * #adapt, so there is nothing to save between calls.
+   */
+  template<class Archive>
+  void serialize(Archive& ar, const unsigned version);
+
+  /*
+   * Boost.Serialization requirements.
+   */
+  friend class boost::serialization::access;
+};
+}
+
+#include "../model/Model.hpp"
+#include "../math/constant.hpp"
+#include "../math/scalar.hpp"
+#include "../math/view.hpp"
+#include "../math/operation.hpp"
+#include "../math/temp_vector.hpp"
+#include "../math/temp_matrix.hpp"
+#include "../pdf/misc.hpp"
+#include "../primitive/vector_primitive.hpp"
+#include "../primitive/matrix_primitive.hpp"
+#include "../cuda/cuda.hpp"
+#include "../mpi/mpi.hpp"
+
+template<class S1>
+bool bi::MixtureAdapter::adapt(const S1& s) {
+  const int NP = s.s1s[0]->get(P_VAR).size2();
+  const int P = s.size();
+
+  bool ready = s.ess >= essRel * P;
+  if (ready) {
+    try {
+      typename temp_host_matrix<real>::type X(P, NP);
+
+      /* copy samples into single matrix */
+      for (int p = 0; p < P; ++p) {
+        row(X, p) = vec(s.s1s[p]->get(P_VAR));
+      }
+      synchronize();
+
+      fit(X, s.logWeights(), s.ess);
+    } catch (CholeskyException e) {
+      ready = false;
+    }
+  }
+  return ready;
+}
+
+template<class M1, class V1>
+bool bi::MixtureAdapter::adapt(const M1 X, const V1 lws) {
+  const int P = X.size1();
+  const double ess = ess_reduce(lws);
+
+  bool ready = ess >= essRel * P;
+  if (ready) {
+    try {
+      fit(X, lws, ess);
+    } catch (CholeskyException e) {
+      ready = false;
+    }
+  }
+  return ready;
+}
+
+#ifdef ENABLE_MPI
+template<class S1>
+bool bi::MixtureAdapter::distributedAdapt(const S1& s) {
+  boost::mpi::communicator world;
+  const int size = world.size();
+  const int NP = s.s1s[0]->get(P_VAR).size2();
+  const int P = s.size();
+
+  bool ready = s.ess >= essRel * P * size;
+  if (ready) {
+    try {
+      typename temp_host_matrix<real>::type X(P, NP), Xs(P * NP, size),
+          Y(P * size, NP), lwss(P, size);
+      typename temp_host_vector<real>::type lws(P);
+
+      /* copy samples into single matrix */
+      for (int p = 0; p < P; ++p) {
+        row(X, p) = vec(s.s1s[p]->get(P_VAR));
+      }
+      lws = s.logWeights();
+      synchronize();
+
+      /* mixture is over all samples, so gather them */
+      boost::mpi::all_gather(world, X.buf(), P * NP, Xs.buf());
+      boost::mpi::all_gather(world, lws.buf(), P, lwss.buf());
+      for (int k = 0; k < size; ++k) {
+        rows(Y, k * P, P) = reshape(columns(Xs, k, 1), P, NP);
+      }
+
+      fit(Y, vec(lwss), s.ess);
+    } catch (CholeskyException e) {
+      ready = false;
+    }
+  }
+  return ready;
+}
+#endif
+
+template<class S1, class S2>
+void bi::MixtureAdapter::propose(Random& rng, S1& s1, S2& s2) {
+  BOOST_AUTO(theta1, vec(s1.get(P_VAR)));
+  BOOST_AUTO(theta2, vec(s2.get(P_VAR)));
+
+  const int N = theta1.size();
+  typename temp_host_vector<real>::type htheta1(N), htheta2(N);
+  htheta1 = theta1;
+  synchronize();
+
+  /* draw component, then from component */
+  int k = rng.multinomial(lpis);
+  rng.gaussians(htheta2);
+  trmv(columns(Us, k * N, N), htheta2, 'U', 'T');
+  axpy(1.0, row(Mu, k), htheta2);
+
+  s1.logProposal = logDensity(htheta1);
+  s2.logProposal = logDensity(htheta2);
+
+  theta2 = htheta2;
+
+  synchronize();
+}
+
+template<class M1, class V1>
+void bi::MixtureAdapter::fit(const M1 X, const V1 lws, const double ess) {
+  const int P = X.size1();
+  const int N = X.size2();
+
+  typename temp_host_vector<real>::type ws(P);
+
+  /* normalised weights */
+  ws = lws;
+  synchronize();
+  subscal_elements(ws, logsumexp_reduce(ws), ws);
+  exp_elements(ws, ws);
+
+  if (K > 0) {
+    em(X, ws, K, Mu, Us, lpis, ldetUs);
+  } else {
+    host_matrix<real> Mu1, Us1;
+    host_vector<real> lpis1, ldetUs1;
+    real ll, bic, minBic = BI_INF;
+    int k, d;
+
+    for (k = 1; k <= MAX_COMPONENTS; ++k) {
+      /* number of free parameters, stop when not identifiable */
+      d = k * (N + N * (N + 1) / 2) + k - 1;
+      if (k > 1 && d >= ess) {
+        break;
+      }
+
+      ll = em(X, ws, k, Mu1, Us1, lpis1, ldetUs1);
+      bic = -2.0 * ess * ll + d * bi::log(ess);
+      if (k == 1 || bic < minBic) {
+        minBic = bic;
+        Mu.swap(Mu1);
+        Us.swap(Us1);
+        lpis.swap(lpis1);
+        ldetUs.swap(ldetUs1);
+      }
+    }
+  }
+}
+
+template<class M1, class V1, class M2, class M3, class V2, class V3>
+real bi::MixtureAdapter::em(const M1 X, const V1 ws, const int K,
+    M2& Mu, M3& Us, V2& lpis, V3& ldetUs) {
+  const int P = X.size1();
+  const int N = X.size2();
+
+  typename temp_host_matrix<real>::type Z(P, N), Sigma(N, N), U(N, N), Rs(K,
+      P);
+  typename temp_host_vector<real>::type mu(N), e(N), ds(P);
+
+  Mu.resize(K, N);
+  Us.resize(N, K * N);
+  lpis.resize(K);
+  ldetUs.resize(K);
+
+  /* sample mean and covariance */
+  mean(X, ws, mu);
+  cov(X, ws, mu, Sigma);
+  chol(Sigma, U);
+  ridge = 1.0e-6 * sum_reduce(diagonal(Sigma)) / N;
+
+  /* standardised samples */
+  Z = X;
+  sub_rows(Z, mu);
+  trsm(1.0, U, Z, 'R', 'U');
+
+  /* initial means, greedily far apart, starting with the heaviest sample;
+   * ds holds the weighted squared distance to the nearest mean so far */
+  int k, p, q = 0;
+  for (p = 1; p < P; ++p) {
+    if (ws(p) > ws(q)) {
+      q = p;
+    }
+  }
+  set_elements(ds, BI_INF);
+  for (k = 0; k < K; ++k) {
+    row(Mu, k) = row(X, q);
+    for (p = 0; p < P; ++p) {
+      e = row(Z, p);
+      axpy(-1.0, row(Z, q), e);
+      ds(p) = bi::min(ds(p), ws(p) * dot(e));
+    }
+    q = 0;
+    for (p = 1; p < P; ++p) {
+      if (ds(p) > ds(q)) {
+        q = p;
+      }
+    }
+  }
+
+  /* initial covariances and mixing proportions */
+  for (k = 0; k < K; ++k) {
+    columns(Us, k * N, N) = U;
+  }
+  set_elements(lpis, -bi::log(real(K)));
+  set_elements(ldetUs, bi::log(prod_reduce(diagonal(U))));
+
+  /* iterate */
+  real ll = -BI_INF, ll1;
+  int iter = 0;
+  do {
+    ll1 = ll;
+    ll = estep(X, ws, Mu, Us, lpis, ldetUs, Rs);
+    mstep(X, ws, Rs, Mu, Us, lpis, ldetUs);
+    ++iter;
+  } while (iter < MAX_ITERATIONS
+      && bi::abs(ll - ll1) > 1.0e-6 * bi::abs(ll));
+
+  return estep(X, ws, Mu, Us, lpis, ldetUs, Rs);
+}
+
+template<class M1, class V1, class M2, class M3, class V2, class V3,
+    class M4>
+real bi::MixtureAdapter::estep(const M1 X, const V1 ws, const M2 Mu,
+    const M3 Us, const V2 lpis, const V3 ldetUs, M4 Rs) {
+  const int P = X.size1();
+  const int N = X.size2();
+  const int K = Mu.size1();
+
+  typename temp_host_matrix<real>::type Y(P, N);
+  typename temp_host_vector<real>::type lls(P);
+  int k, p;
+
+  /* log-densities under each component, parallel over samples */
+  for (k = 0; k < K; ++k) {
+    const real c = lpis(k) - N * BI_HALF_LOG_TWO_PI - ldetUs(k);
+    BOOST_AUTO(U, columns(Us, k * N, N));
+
+    Y = X;
+    sub_rows(Y, row(Mu, k));
+
+    #pragma omp parallel for private(p)
+    for (p = 0; p < P; ++p) {
+      BOOST_AUTO(y, row(Y, p));
+      trsv(U, y, 'U', 'T');
+      Rs(k, p) = c - 0.5 * dot(y);
+    }
+  }
+
+  /* normalise to responsibilities, parallel over samples */
+  #pragma omp parallel for private(p)
+  for (p = 0; p < P; ++p) {
+    BOOST_AUTO(r, column(Rs, p));
+    lls(p) = logsumexp_reduce(r);
+    subscal_elements(r, lls(p), r);
+    exp_elements(r, r);
+  }
+
+  return dot(ws, lls);
+}
+
+template<class M1, class V1, class M2, class M3, class M4, class V2,
+    class V3>
+void bi::MixtureAdapter::mstep(const M1 X, const V1 ws, const M2 Rs, M3 Mu,
+    M4 Us, V2 lpis, V3 ldetUs) {
+  const int P = X.size1();
+  const int N = X.size2();
+  const int K = Mu.size1();
+
+  typename temp_host_matrix<real>::type Y(P, N), Z(P, N), Sigma(N, N);
+  typename temp_host_vector<real>::type vs(P);
+  real W;
+
+  for (int k = 0; k < K; ++k) {
+    BOOST_AUTO(U, columns(Us, k * N, N));
+
+    /* sample weights times responsibilities */
+    vs = row(Rs, k);
+    mul_elements(vs, ws, vs);
+    W = sum_reduce(vs);
+
+    /* an empty component keeps its mean and covariance, and is never
+     * proposed from */
+    lpis(k) = bi::log(W);
+    if (W > 0.0) {
+      /* mean */
+      gemv(1.0 / W, X, vs, 0.0, row(Mu, k), 'T');
+
+      /* covariance */
+      Y = X;
+      sub_rows(Y, row(Mu, k));
+      sqrt_elements(vs, vs);
+      gdmm(1.0, vs, Y, 0.0, Z);
+      syrk(1.0 / W, Z, 0.0, Sigma, 'U', 'T');
+      addscal_elements(diagonal(Sigma), ridge, diagonal(Sigma));
+
+      /* Cholesky factor */
+      chol(Sigma, U);
+      ldetUs(k) = bi::log(prod_reduce(diagonal(U)));
+    }
+  }
+}
+
+template<class V1>
+real bi::MixtureAdapter::logDensity(const V1 x) {
+  const int N = x.size();
+  const int K = Mu.size1();
+
+  typename temp_host_vector<real>::type y(N), lps(K);
+
+  for (int k = 0; k < K; ++k) {
+    y = x;
+    axpy(-1.0, row(Mu, k), y);
+    trsv(columns(Us, k * N, N), y, 'U', 'T');
+    lps(k) = lpis(k) - 0.5 * dot(y) - N * BI_HALF_LOG_TWO_PI - ldetUs(k);
+  }
+  return logsumexp_reduce(lps);
+}
+
+template<class Archive>
+void bi::MixtureAdapter::serialize(Archive& ar, const unsigned version) {
+  //
+}
+
+#endif
@@ -38,9 +38,16 @@ public:
    * @param stopper Stopping criterion for adapting number of particles.
    * @param initialP Number of particles at first time.
    * @param blockP Number of particles per block.
+   * @param speculative Propagate blocks speculatively?
+   *
+   * In speculative mode, several blocks are propagated at once, as many as
+   * were needed at the previous step, so that there is enough work to keep
+   * all threads busy. The stopping criterion is still applied block by
+   * block, and blocks after the stopping block are discarded, so that the
+   * result is distributed as if blocks had been propagated one at a time.
    */
   AdaptivePF(B& m, F& in, O& obs, R& resam, S2& stopper, const int initialP,
-      const int blockP);
+      const int blockP, const bool speculative = false);
 
   /**
    * @copydoc BootstrapPF::init()
@@ -84,6 +91,56 @@ public:
   //@}
 
 private:
+  /**
+   * Choose where to place the next generation of particles in the state.
+   *
+   * @tparam S1 State type.
+   *
+   * @param s State, with active range set to the current generation.
+   *
+   * @return Starting index for the next generation.
+   *
+   * The state is used as a ring of two regions, with the next generation
+   * written either in front of or behind the current generation, so that
+   * the current generation can be read in place while the next is written.
+   */
+  template<class S1>
+  int place(const S1& s);
+
+  /**
+   * Reserve space in the state for more blocks of the next generation.
+   *
+   * @tparam S1 State type.
+   *
+   * @param[in,out] s State.
+   * @param o Starting index of current generation.
+   * @param P Size of current generation.
+   * @param n Starting index of next generation.
+   * @param block Number of blocks of the next generation already
+   * propagated.
+   * @param nblocks Number of additional blocks.
+   *
+   * @return Starting index of next generation, which changes only if it
+   * must be moved to avoid overrunning the current generation.
+   */
+  template<class S1>
+  int reserve(S1& s, const int o, const int P, const int n,
+      const int block, const int nblocks);
+
+  /**
+   * Grow state capacity geometrically.
+   *
+   * @tparam S1 State type.
+   *
+   * @param[in,out] s State.
+   * @param maxP Minimum capacity required.
+   *
+   * Capacity is at least doubled on each reallocation, so that the cost of
+   * growth is amortised over blocks.
+   */
+  template<class S1>
+  void grow(S1& s, const int maxP);
+
   /**
    * Stopping criterion.
    */
@@ -98,6 +155,17 @@ private:
    * Block size.
    */
   int blockP;
+
+  /**
+   * Propagate blocks speculatively?
+   */
+  bool speculative;
+
+  /**
+   * Number of blocks propagated at the last step, up to and including the
+   * stopping block.
+   */
+  int lastBlocks;
 };
 }
 
@@ -106,9 +174,10 @@ private:
 
 template<class B, class F, class O, class R, class S2>
 bi::AdaptivePF<B,F,O,R,S2>::AdaptivePF(B& m, F& in, O& obs, R& resam,
-    S2& stopper, const int initialP, const int blockP) :
+    S2& stopper, const int initialP, const int blockP,
+    const bool speculative) :
     BootstrapPF<B,F,O,R>(m, in, obs, resam), stopper(stopper), initialP(
-        initialP), blockP(blockP) {
+        initialP), blockP(blockP), speculative(speculative), lastBlocks(1) {
   //
 }
 
@@ -138,24 +207,20 @@ template<class B, class F, class O, class R, class S2>
 template<class S1, class IO1>
 void bi::AdaptivePF<B,F,O,R,S2>::step(Random& rng, ScheduleIterator& iter,
     const ScheduleIterator last, S1& s, IO1& out) {
-  typedef typename loc_temp_vector<S1::location,real>::type vector_type;
-  typedef typename loc_temp_matrix<S1::location,real>::type matrix_type;
-  typedef typename loc_temp_vector<S1::location,int>::type int_vector_type;
-
+  /* the new generation of particles is written to rows of the state that
+   * do not overlap with the current generation, which is read in place
+   * through views, so that neither needs to be copied; see #place */
   const int P = s.size();
-  const int N = s.getDyn().size2();
+  const int o = s.start();
 
-  /* state at current time */
-  matrix_type X(P, N);
-  vector_type lws(P);
-  int_vector_type as(P);
+  /* in speculative mode, blocks are propagated in batches, the first sized
+   * by the number of blocks needed at the last step */
+  const int batch = speculative ? bi::max(lastBlocks, 1) : 1;
+  typename S1::temp_int_vector_type as1(batch * blockP);
 
-  X = s.getDyn();
-  lws = s.logWeights();
-  as = s.ancestors();
-
-  int block = 0;
+  int block = 0, nblocks, b, n = place(s);
   double maxlw, ll = 0.0;
+  bool stop = false;
   BOOST_AUTO(iter1, iter);
 
   /* marginal log-likelihood increment */
@@ -169,13 +234,19 @@ void bi::AdaptivePF<B,F,O,R,S2>::step(Random& rng, ScheduleIterator& iter,
   typename precompute_type<R,S1::location>::type pre;
   this->resam.precompute(s.logWeights(), pre);
 
-  /* propagate block by block */
+  /* propagate batch by batch */
   this->stopper.reset();
   do {
-    if (s.sizeMax() < (block + 1) * blockP) {
-      s.resizeMax((block + 1) * blockP);
-    }
-    s.setRange(block * blockP, blockP);
+    nblocks = batch;
+    n = reserve(s, o, P, n, block, nblocks);
+
+    /* views of current generation, taken after any reallocation */
+    s.setRange(o, P);
+    BOOST_AUTO(X, s.getDyn());
+    BOOST_AUTO(lws, s.logWeights());
+    BOOST_AUTO(as, s.ancestors());
+
+    s.setRange(n + block * blockP, nblocks * blockP);
     iter1 = iter;
 
     do {
@@ -185,7 +256,6 @@ void bi::AdaptivePF<B,F,O,R,S2>::step(Random& rng, ScheduleIterator& iter,
           this->resam.ancestors(rng, lws, s.ancestors(), pre);
           this->resam.copy(s.ancestors(), X, s.getDyn());
         } else {
-          typename S1::temp_int_vector_type as1(blockP);
           this->resam.ancestors(rng, lws, as1, pre);
           this->resam.copy(as1, X, s.getDyn());
           bi::gather(as1, as, s.ancestors());
@@ -201,22 +271,77 @@ void bi::AdaptivePF<B,F,O,R,S2>::step(Random& rng, ScheduleIterator& iter,
       output(*iter1, s, out);
     } while (iter1 + 1 != last && !iter1->isObserved());
 
+    /* apply stopping criterion block by block, as if the blocks had been
+     * propagated one at a time; blocks after the stopping block are
+     * surplus, and are discarded along with the stopping block itself */
     if (iter1->isObserved()) {  // may not be observed at last time
       if (block == 0) {
         maxlw = this->getMaxLogWeight(*iter1, s);
       }
-      stopper.add(s.logWeights(), maxlw);
+      for (b = 0; !stop && b < nblocks; ++b) {
+        stopper.add(subrange(s.logWeights(), b * blockP, blockP), maxlw);
+        ++block;
+        stop = stopper.stop(maxlw);
+      }
+    } else {
+      ++block;
+      stop = true;
     }
-    ++block;
-  } while (iter1->isObserved() && !stopper.stop(maxlw));  // may not be observed at last time
+  } while (!stop);
+  lastBlocks = block;
 
   int length = bi::max(block - 1, 1) * blockP;  // drop last block
   out.push(length);
-  s.setRange(0, length);
+  s.setRange(n, length);
   //s.trim(); // optional, saves memory but means reallocation
   iter = iter1;  // caller expects iter to be advanced at end of step()
 }
 
+template<class B, class F, class O, class R, class S2>
+template<class S1>
+int bi::AdaptivePF<B,F,O,R,S2>::place(const S1& s) {
+  const int o = s.start();
+  const int P = s.size();
+
+  /* in front of the current generation if there is room for as many
+   * particles as it has, otherwise behind */
+  return (o >= P) ? 0 : o + P;
+}
+
+template<class B, class F, class O, class R, class S2>
+template<class S1>
+int bi::AdaptivePF<B,F,O,R,S2>::reserve(S1& s, const int o, const int P,
+    const int n, const int block, const int nblocks) {
+  int n1 = n;
+  if (n1 < o && n1 + (block + nblocks) * blockP > o) {
+    /* new generation would overrun current generation, move it behind */
+    n1 = o + P;
+    grow(s, n1 + (block + nblocks) * blockP);
+    if (block > 0) {
+      s.setRange(n, block * blockP);
+      BOOST_AUTO(X, s.getDyn());
+      BOOST_AUTO(lws, s.logWeights());
+      BOOST_AUTO(as, s.ancestors());
+
+      s.setRange(n1, block * blockP);
+      s.getDyn() = X;
+      s.logWeights() = lws;
+      s.ancestors() = as;
+    }
+  } else {
+    grow(s, n1 + (block + nblocks) * blockP);
+  }
+  return n1;
+}
+
+template<class B, class F, class O, class R, class S2>
+template<class S1>
+void bi::AdaptivePF<B,F,O,R,S2>::grow(S1& s, const int maxP) {
+  if (s.sizeMax() < maxP) {
+    s.resizeMax(bi::max(maxP, 2 * s.sizeMax()), true);
+  }
+}
+
 template<class B, class F, class O, class R, class S2>
 template<class S1, class IO1>
 void bi::AdaptivePF<B,F,O,R,S2>::output(const ScheduleElement now,
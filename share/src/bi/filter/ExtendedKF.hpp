@@ -92,6 +92,19 @@ public:
   //@}
 
 protected:
+  /**
+   * Construct projection from mask to observed variables.
+   *
+   * @tparam M1 Mask type.
+   * @tparam V1 Integer vector type.
+   *
+   * @param mask Observation mask.
+   * @param[out] map Serialised indices of the observed variables in the
+   * mask.
+   */
+  template<class M1, class V1>
+  void project(const M1& mask, V1 map);
+
   /*
    * Sizes for convenience.
    */
@@ -211,38 +224,41 @@ template<class B, class F, class O>
 template<class S1>
 void bi::ExtendedKF<B,F,O>::correct(Random& rng, const ScheduleElement now,
     S1& s) throw (CholeskyException) {
-  typedef typename loc_temp_matrix<S1::location,real>::type matrix_type;
-  typedef typename loc_temp_vector<S1::location,real>::type vector_type;
-  typedef typename loc_temp_vector<S1::location,int>::type int_vector_type;
-
   s.mu2 = s.mu1;
   s.U2 = s.U1;
 
   if (now.isObserved()) {
     BOOST_AUTO(mask, this->obs.getMask(now.indexObs()));
+    const int k = now.indexObs();
     const int W = mask.size();
 
     this->observe(rng, s);
 
-    matrix_type C(M, W), U3(W, W), Sigma3(W, W), R3(W, W);
-    vector_type y(W), z(W), mu3(W);
-    int_vector_type map(W);
-
-    /* construct projection from mask */
-    Var* var;
-    int id, start = 0, size;
-    for (id = 0; id < this->m.getNumVars(O_VAR); ++id) {
-      var = this->m.getVar(O_VAR, id);
-      size = mask.getSize(id);
-
-      if (mask.isSparse(id)) {
-        addscal_elements(mask.getIndices(id), var->getStart(),
-            subrange(map, start, size));
-      } else {
-        seq_elements(subrange(map, start, size), var->getStart());
-      }
-      start += size;
+    /* projection from mask, constructed on first use of this observation
+     * index only */
+    if (k >= s.maps.size()) {
+      s.maps.resize(k + 1);
+    }
+    if (!s.maps.isValid(k)) {
+      typename S1::temp_int_vector_type map(W);
+      project(mask, map);
+
+      /* page must be sized before it is written */
+      s.maps.setValid(k);
+      s.maps.get(k).resize(W, false);
+      s.maps.set(k, map);
     }
+    const typename S1::int_vector_type& map = s.maps.get(k);
+
+    /* workspace */
+    s.reserve(W);
+    BOOST_AUTO(C, columns(s.C3, 0, W));
+    BOOST_AUTO(U3, subrange(s.U3, 0, W, 0, W));
+    BOOST_AUTO(Sigma3, subrange(s.Sigma3, 0, W, 0, W));
+    BOOST_AUTO(R3, subrange(s.R3, 0, W, 0, W));
+    BOOST_AUTO(y, subrange(s.y3, 0, W));
+    BOOST_AUTO(z, subrange(s.z3, 0, W));
+    BOOST_AUTO(mu3, subrange(s.mu3, 0, W));
 
     /* project matrices and vectors to active variables in mask */
     gather_columns(map, s.G(), C);
@@ -279,4 +295,23 @@ void bi::ExtendedKF<B,F,O>::correct(Random& rng, const ScheduleElement now,
   }
 }
 
+template<class B, class F, class O>
+template<class M1, class V1>
+void bi::ExtendedKF<B,F,O>::project(const M1& mask, V1 map) {
+  Var* var;
+  int id, start = 0, size;
+  for (id = 0; id < this->m.getNumVars(O_VAR); ++id) {
+    var = this->m.getVar(O_VAR, id);
+    size = mask.getSize(id);
+
+    if (mask.isSparse(id)) {
+      addscal_elements(mask.getIndices(id), var->getStart(),
+          subrange(map, start, size));
+    } else {
+      seq_elements(subrange(map, start, size), var->getStart());
+    }
+    start += size;
+  }
+}
+
 #endif
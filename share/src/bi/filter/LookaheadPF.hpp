@@ -68,8 +68,6 @@ public:
 };
 }
 
-#include "../math/loc_temp_matrix.hpp"
-
 template<class B, class F, class O, class R>
 bi::LookaheadPF<B,F,O,R>::LookaheadPF(B& m, F& in, O& obs, R& resam) :
     BridgePF<B,F,O,R>(m, in, obs, resam) {
@@ -98,29 +96,24 @@ void bi::LookaheadPF<B,F,O,R>::bridge(Random& rng,
     axpy(-1.0, s.logAuxWeights(), s.logWeights());
     s.logAuxWeights().clear();
 
-    /* save previous state */
-    typename loc_temp_matrix<S1::location,real>::type X(s.getDyn().size1(),
-        s.getDyn().size2());
-    X = s.getDyn();
-    real t = s.getTime();
-    real tInput = s.getLastInputTime();
-    real tObs = s.getNextObsTime();
+    /* lookahead is performed on a scratch state, so that the particles
+     * need not be saved and restored around it */
+    const int P = s.size();
+    if (s.lookaheadState.sizeMax() < P) {
+      s.lookaheadState.resizeMax(P, false);
+    }
+    s.lookaheadState.setRange(0, P);
+    s.lookaheadState = s;
 
     /* lookahead */
     ScheduleIterator iter1 = iter;
     do {
       ++iter1;
-      this->lookahead(rng, *iter1, s);
+      this->lookahead(rng, *iter1, s.lookaheadState);
     } while (!iter1->isObserved());
-    this->m.lookaheadObservationLogDensities(s,
+    this->m.lookaheadObservationLogDensities(s.lookaheadState,
         this->obs.getMask(iter1->indexObs()), s.logAuxWeights());
 
-    /* restore previous state */
-    s.getDyn() = X;
-    s.setTime(t);
-    s.setLastInputTime(tInput);
-    s.setNextObsTime(tObs);
-
     axpy(1.0, s.logAuxWeights(), s.logWeights());
   }
 }
@@ -0,0 +1,326 @@
+/**
+ * @file
+ *
+ * @author Lawrence Murray <lawrence.murray@csiro.au>
+ * $Rev$
+ * $Date$
+ */
+#ifndef BI_FILTER_PARTICLETUNER_HPP
+#define BI_FILTER_PARTICLETUNER_HPP
+
+#include "../random/Random.hpp"
+#include "../state/Schedule.hpp"
+
+#include <vector>
+
+namespace bi {
+/**
+ * Tuning of the number of particles of a particle filter for use within
+ * particle marginal Metropolis-Hastings.
+ *
+ * @ingroup method_filter
+ *
+ * @tparam B Model type
+ * @tparam F #concept::Filter type.
+ *
+ * Runs the filter repeatedly at a fixed parameter, for a doubling number of
+ * particles, estimating the standard deviation \f$\sigma\f$ of the
+ * log-likelihood estimate and the time taken by each run. The variance is
+ * assumed inversely proportional to the number of particles, and fitted as
+ * such across all numbers of particles tried. The recommended number of
+ * particles is that which minimises the time taken per effective sample,
+ * using the approximation of @ref Pitt2012 "Pitt et al. (2012)" for the
+ * inefficiency of an independent proposal given a noisy log-likelihood:
+ * with acceptance rate \f$\alpha = 2\Phi(-\sigma/\sqrt{2})\f$, the
+ * inefficiency is \f$(2 - \alpha)/\alpha\f$. This is minimised, in time per
+ * effective sample, near \f$\sigma = 1.5\f$.
+ *
+ * Replicates run in parallel, one per thread, sharing the filter, as for
+ * MultiStartOptimiser. The first is run serially, after which the input and
+ * observation caches of the filter are full. This rules out AdaptivePF.
+ */
+template<class B, class F>
+class ParticleTuner {
+public:
+  /**
+   * Constructor.
+   *
+   * @param m Model.
+   * @param filter Filter.
+   * @param maxP Maximum number of particles to try.
+   */
+  ParticleTuner(B& m, F& filter, const int maxP = 32768);
+
+  /**
+   * @name High-level interface
+   *
+   * An easier interface for common usage.
+   */
+  //@{
+  /**
+   * Tune.
+   *
+   * @tparam S1 State type.
+   * @tparam IO1 Output type.
+   * @tparam IO2 Input type.
+   *
+   * @param[in,out] rng Random number generator.
+   * @param first Start of time schedule.
+   * @param last End of time schedule.
+   * @param[in,out] ss States, one per replicate.
+   * @param[in,out] outs Output buffers, one per replicate.
+   * @param inInit Initialisation file, giving the parameter at which to
+   * tune.
+   * @param P Number of particles with which to start.
+   *
+   * @return Recommended number of particles.
+   *
+   * The number of particles is doubled from @p P until the standard
+   * deviation of the log-likelihood falls below one, or the maximum number
+   * of particles is reached.
+   */
+  template<class S1, class IO1, class IO2>
+  int tune(Random& rng, const ScheduleIterator first,
+      const ScheduleIterator last, std::vector<S1*>& ss,
+      std::vector<IO1*>& outs, IO2& inInit, const int P);
+  //@}
+
+  /**
+   * @name Low-level interface
+   *
+   * Largely used by other features of the library or for finer control over
+   * performance and behaviour.
+   */
+  //@{
+  /**
+   * Inefficiency of particle marginal Metropolis-Hastings.
+   *
+   * @param sd Standard deviation of log-likelihood estimate.
+   *
+   * @return Inefficiency, relative to the exact likelihood.
+   */
+  static double inefficiency(const double sd);
+
+  /**
+   * Report progress on stderr.
+   *
+   * @param P Number of particles.
+   * @param ll Mean log-likelihood.
+   * @param sd Standard deviation of log-likelihood.
+   * @param t Mean time per run, in seconds.
+   */
+  void report(const int P, const double ll, const double sd,
+      const double t);
+
+  /**
+   * Report result on stderr.
+   *
+   * @param P Recommended number of particles.
+   * @param sd Fitted standard deviation of log-likelihood at @p P.
+   */
+  void reportT(const int P, const double sd);
+  //@}
+
+private:
+  /**
+   * Run one replicate.
+   *
+   * @return Log-likelihood estimate.
+   */
+  template<class S1, class IO1>
+  double run(Random& rng, const ScheduleIterator first,
+      const ScheduleIterator last, const S1& s0, const int P, S1& s,
+      IO1& out);
+
+  /**
+   * Model.
+   */
+  B& m;
+
+  /**
+   * Filter.
+   */
+  F& filter;
+
+  /**
+   * Maximum number of particles.
+   */
+  int maxP;
+};
+
+/**
+ * Factory for creating ParticleTuner objects.
+ *
+ * @ingroup method_filter
+ *
+ * @tparam CL Cache location.
+ *
+ * @see ParticleTuner
+ */
+template<Location CL = ON_HOST>
+struct ParticleTunerFactory {
+  /**
+   * Create particle tuner.
+   *
+   * @return ParticleTuner object. Caller has ownership.
+   *
+   * @see ParticleTuner::ParticleTuner()
+   */
+  template<class B, class F>
+  static ParticleTuner<B,F>* create(B& m, F& filter, const int maxP =
+      32768) {
+    return new ParticleTuner<B,F>(m, filter, maxP);
+  }
+};
+}
+
+#include "../misc/exception.hpp"
+#include "../math/function.hpp"
+#include "../math/misc.hpp"
+#include "../math/constant.hpp"
+
+#include <iostream>
+#include <iomanip>
+
+template<class B, class F>
+bi::ParticleTuner<B,F>::ParticleTuner(B& m, F& filter, const int maxP) :
+    m(m), filter(filter), maxP(maxP) {
+  //
+}
+
+template<class B, class F>
+template<class S1, class IO1, class IO2>
+int bi::ParticleTuner<B,F>::tune(Random& rng, const ScheduleIterator first,
+    const ScheduleIterator last, std::vector<S1*>& ss,
+    std::vector<IO1*>& outs, IO2& inInit, const int P) {
+  /* pre-condition */
+  BI_ASSERT(ss.size() == outs.size());
+  BI_ASSERT(ss.size() > 1);
+
+  const int nreps = ss.size();
+  std::vector<double> lls(nreps), ts(nreps);
+  std::vector<int> Ps;
+  std::vector<double> vars, times;
+  double sd = BI_INF, mean, var;
+  int i, j, start, Q = bi::roundup(P);
+
+  /* reference state holding the parameter, copied with replicate(), as
+   * copy construction of states is shallow */
+  ss[0]->resizeMax(Q, false);
+  ss[0]->setRange(0, Q);
+  filter.init(rng, *first, *ss[0], *outs[0], inInit);
+  S1 s0(Q);
+  filter.replicate(rng, *first, *ss[0], s0, *outs[0]);
+
+  do {
+    /* the first replicate fills the input and observation caches of the
+     * filter, the rest then run in parallel */
+    start = 0;
+    if (Ps.empty()) {
+      lls[0] = run(rng, first, last, s0, Q, *ss[0], *outs[0]);
+      ts[0] = ss[0]->clock / 1.0e6;
+      start = 1;
+    }
+    #pragma omp parallel for schedule(dynamic)
+    for (i = start; i < nreps; ++i) {
+      lls[i] = run(rng, first, last, s0, Q, *ss[i], *outs[i]);
+      ts[i] = ss[i]->clock / 1.0e6;
+    }
+
+    mean = 0.0;
+    var = 0.0;
+    for (i = 0; i < nreps; ++i) {
+      mean += lls[i];
+    }
+    mean /= nreps;
+    for (i = 0; i < nreps; ++i) {
+      var += (lls[i] - mean) * (lls[i] - mean);
+    }
+    var /= nreps - 1;
+    if (!bi::is_finite(var)) {
+      var = BI_INF;
+    }
+    sd = bi::sqrt(var);
+
+    Ps.push_back(Q);
+    vars.push_back(var);
+    times.push_back(0.0);
+    for (i = 0; i < nreps; ++i) {
+      times.back() += ts[i];
+    }
+    times.back() /= nreps;
+
+    report(Q, mean, sd, times.back());
+    Q *= 2;
+  } while (sd >= 1.0 && Q <= maxP);
+
+  /* fit variance inversely proportional to number of particles, then
+   * minimise time per effective sample */
+  double c = 0.0;
+  int n = 0;
+  for (j = 0; j < int(Ps.size()); ++j) {
+    if (bi::is_finite(vars[j])) {
+      c += vars[j] * Ps[j];
+      ++n;
+    }
+  }
+  c = (n > 0) ? c / n : BI_INF;
+
+  double cost, minCost = BI_INF;
+  int best = Ps.size() - 1;
+  for (j = 0; j < int(Ps.size()); ++j) {
+    cost = times[j] * inefficiency(bi::sqrt(c / Ps[j]));
+    if (cost < minCost) {
+      minCost = cost;
+      best = j;
+    }
+  }
+  reportT(Ps[best], bi::sqrt(c / Ps[best]));
+
+  return Ps[best];
+}
+
+template<class B, class F>
+template<class S1, class IO1>
+double bi::ParticleTuner<B,F>::run(Random& rng, const ScheduleIterator first,
+    const ScheduleIterator last, const S1& s0, const int P, S1& s,
+    IO1& out) {
+  s.resizeMax(P, false);
+  s.setRange(0, P);
+  try {
+    filter.replicate(rng, *first, s0, s, out);
+    filter.filter(rng, first, last, s, out);
+    return s.logLikelihood;
+  } catch (CholeskyException e) {
+    return -BI_INF;
+  } catch (ParticleFilterDegeneratedException e) {
+    return -BI_INF;
+  }
+}
+
+template<class B, class F>
+double bi::ParticleTuner<B,F>::inefficiency(const double sd) {
+  double alpha = bi::erfc(0.5 * sd);  // 2*Phi(-sd/sqrt(2))
+  return (alpha > 0.0) ? (2.0 - alpha) / alpha : BI_INF;
+}
+
+template<class B, class F>
+void bi::ParticleTuner<B,F>::report(const int P, const double ll,
+    const double sd, const double t) {
+  std::cerr << std::fixed << std::setprecision(3);
+  std::cerr << "P " << P;
+  std::cerr << "\tmean " << ll;
+  std::cerr << "\tsd " << sd;
+  std::cerr << "\ttime " << t;
+  std::cerr << std::endl;
+}
+
+template<class B, class F>
+void bi::ParticleTuner<B,F>::reportT(const int P, const double sd) {
+  std::cerr << std::fixed << std::setprecision(3);
+  std::cerr << "recommended P " << P;
+  std::cerr << "\tfitted sd " << sd;
+  std::cerr << std::endl;
+}
+
+#endif
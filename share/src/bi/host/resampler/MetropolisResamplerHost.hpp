@@ -10,9 +10,24 @@
 
 #include "ResamplerHost.hpp"
 
+/**
+ * @def BI_METROPOLIS_BLOCK_SIZE
+ *
+ * Number of particles processed together by MetropolisResamplerHost.
+ */
+#define BI_METROPOLIS_BLOCK_SIZE 64
+
 namespace bi {
 /**
  * MetropolisResampler implementation on host.
+ *
+ * Particles are processed in blocks of #BI_METROPOLIS_BLOCK_SIZE lanes,
+ * rather than one at a time. Each Metropolis step of a block draws the
+ * uniform variates for all lanes at once, gathers the proposed weights, and
+ * accepts or rejects without branches, so that the inner loops over lanes
+ * may be vectorised by the compiler. The comparison is with the log of a
+ * uniform variate, i.e. a negative exponential variate, computed for all
+ * lanes together.
  */
 class MetropolisResamplerHost: public ResamplerHost {
 public:
@@ -30,35 +45,53 @@ public:
 };
 }
 
+#include "../math/vector.hpp"
+
 template<class V1, class V2>
 void bi::MetropolisResamplerHost::ancestors(Random& rng, const V1 lws,
     V2 as, int B) {
   const int P1 = lws.size(); // number of particles
   const int P2 = as.size(); // number of ancestors to draw
+  const int N = BI_METROPOLIS_BLOCK_SIZE;
 
   #pragma omp parallel
   {
-    real alpha, lw1, lw2;
-    int k, p1, p2, p;
+    real lw1s[N], lw2s[N], us[2*N];
+    int p1s[N], p2s[N];
+    host_vector_reference<real> u(us, 2*N);
+    bool accept;
+    int j, k, n, p;
 
     #pragma omp for
-    for (p = 0; p < P2; ++p) {
-      p1 = p;
-      lw1 = lws(p);
+    for (p = 0; p < P2; p += N) {
+      n = bi::min(N, P2 - p);
+      for (j = 0; j < n; ++j) {
+        p1s[j] = p + j;
+        lw1s[j] = lws(p + j);
+      }
       for (k = 0; k < B; ++k) {
-        p2 = rng.uniformInt(0, P1 - 1);
-        lw2 = lws(p2);
-        alpha = rng.uniform<real>();
+        /* variates for this step of all lanes: first half for proposals,
+         * second half for acceptance, the latter taken to logs, i.e.
+         * negative exponential variates */
+        rng.uniforms(u);
+        for (j = 0; j < n; ++j) {
+          p2s[j] = bi::min(static_cast<int>(us[j]*P1), P1 - 1);
+          lw2s[j] = lws(p2s[j]);
+          us[N + j] = bi::log(us[N + j]);
+        }
 
-        if (bi::log(alpha) < lw2 - lw1) {
-          /* accept */
-          p1 = p2;
-          lw1 = lw2;
+        /* accept or reject, without branches */
+        for (j = 0; j < n; ++j) {
+          accept = us[N + j] < lw2s[j] - lw1s[j];
+          p1s[j] = accept ? p2s[j] : p1s[j];
+          lw1s[j] = accept ? lw2s[j] : lw1s[j];
         }
       }
 
       /* write result */
-      as(p) = p1;
+      for (j = 0; j < n; ++j) {
+        as(p + j) = p1s[j];
+      }
     }
   }
 }
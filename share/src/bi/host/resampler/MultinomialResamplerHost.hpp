@@ -17,9 +17,13 @@ namespace bi {
 class MultinomialResamplerHost: public ResamplerHost {
 public:
   /**
-   * Select ancestors, sorted in ascending order by construction. The basis
-   * of this implementation is the generation of sorted random variates
-   * using the method of @ref Bentley1979 "Bentley & Saxe (1979)".
+   * Select ancestors, sorted in ascending order within the block of each
+   * thread by construction. Each thread generates its share of sorted
+   * uniform variates directly, as the normalised partial sums of
+   * exponential variates, then merges them with the cumulative weights in a
+   * single forward pass, so that the whole is linear in the number of
+   * particles. Compare the method of @ref Bentley1979
+   * "Bentley & Saxe (1979)".
    */
   template<class V1, class V2>
   static void ancestors(Random& rng, const V1 lws, V2 as,
@@ -28,6 +32,8 @@ public:
 };
 }
 
+#include "../math/temp_vector.hpp"
+
 template<class V1, class V2>
 void bi::MultinomialResamplerHost::ancestors(Random& rng, const V1 lws, V2 as,
     ScanResamplerPrecompute<ON_HOST>& pre)
@@ -38,8 +44,6 @@ void bi::MultinomialResamplerHost::ancestors(Random& rng, const V1 lws, V2 as,
   const int lwsSize = lws.size();
 
   if (pre.W > 0) {
-    const T1 lW = bi::log(pre.W);
-
     #pragma omp parallel
     {
       int Q = P/bi_omp_max_threads;
@@ -48,16 +52,29 @@ void bi::MultinomialResamplerHost::ancestors(Random& rng, const V1 lws, V2 as,
         ++Q; // pick up a leftover
       }
 
-      int i, j = lwsSize;
-      T1 lMax = 0.0, lu;
-      for (i = Q; i > 0; --i) {
-        lMax += bi::log(rng.uniform<T1>())/i;
-        lu = lW + lMax;
+      typename temp_host_vector<T1>::type Us(Q + 1);
+      int i, j = 0;
+      T1 S = 0.0, u;
+
+      /* exponential variates, as -log(1 - U) to exclude log(0) */
+      rng.uniforms(Us);
+      for (i = 0; i <= Q; ++i) {
+        Us(i) = -bi::log(static_cast<T1>(1.0) - Us(i));
+      }
+
+      /* partial sums, the last of which normalises */
+      for (i = 0; i <= Q; ++i) {
+        S += Us(i);
+        Us(i) = S;
+      }
 
-        while (j > 0 && lu < bi::log(pre.Ws(j - 1))) {
-          --j;
+      /* merge with cumulative weights */
+      for (i = 0; i < Q; ++i) {
+        u = pre.W*(Us(i)/S);
+        while (j < lwsSize - 1 && pre.Ws(j) <= u) {
+          ++j;
         }
-        as(start + i - 1) = j;
+        as(start + i) = j;
       }
     }
   } else {
@@ -0,0 +1,648 @@
+/**
+ * @file
+ *
+ * @author Lawrence Murray <lawrence.murray@csiro.au>
+ * $Rev$
+ * $Date$
+ */
+#ifndef BI_KD_FLATKDTREE_HPP
+#define BI_KD_FLATKDTREE_HPP
+
+#include "../math/vector.hpp"
+#include "../math/matrix.hpp"
+
+#ifndef __CUDACC__
+#include "boost/serialization/split_member.hpp"
+#endif
+
+#include <vector>
+
+namespace bi {
+/**
+ * \f$kd\f$ (k-dimensional) tree over a weighted sample set, with flat
+ * layout.
+ *
+ * @ingroup kd
+ *
+ * @tparam V1 Vector type.
+ * @tparam M1 Matrix type.
+ *
+ * Unlike KDTree, which allocates each node separately on the heap, all
+ * nodes of a FlatKDTree are stored in contiguous arrays. Each internal node
+ * splits its samples in half by count, at the median of the dimension with
+ * greatest range, so that the tree is balanced and indices are implicit: the
+ * root is node 0, and the children of node @c i are nodes <tt>2i + 1</tt>
+ * and <tt>2i + 2</tt>. Samples are reordered so that those of any node are
+ * contiguous, as are the bounding boxes of all nodes.
+ *
+ * Nodes at the deepest level are leaves, and hold at most a given number of
+ * samples. There are no prune nodes, as all leaves may hold several
+ * samples.
+ */
+template<class V1 = host_vector<>, class M1 = host_matrix<> >
+class FlatKDTree {
+public:
+  /**
+   * Default constructor.
+   *
+   * This should generally only be used when the object is to be
+   * restored from a serialization.
+   */
+  FlatKDTree();
+
+  /**
+   * Constructor.
+   *
+   * @tparam M2 Matrix type.
+   * @tparam V2 Vector type.
+   *
+   * @param X Samples. Rows index samples, columns index variables.
+   * @param lw Log-weights.
+   * @param leafSize Maximum number of samples in each leaf node.
+   */
+  template<class M2, class V2>
+  FlatKDTree(const M2 X, const V2 lw, const int leafSize = 8);
+
+  /**
+   * Constructor.
+   *
+   * @tparam M2 Matrix type.
+   *
+   * @param X Samples. Rows index samples, columns index variables.
+   * @param leafSize Maximum number of samples in each leaf node.
+   */
+  template<class M2>
+  FlatKDTree(const M2 X, const int leafSize = 8);
+
+  /**
+   * Size (number of variables).
+   */
+  int getSize() const;
+
+  /**
+   * Number of samples.
+   */
+  int getCount() const;
+
+  /**
+   * Number of nodes.
+   */
+  int getNumNodes() const;
+
+  /**
+   * Depth of the tree. Zero if the root is a leaf.
+   */
+  int getDepth() const;
+
+  /**
+   * Is a node a leaf node?
+   *
+   * @param i Node index.
+   */
+  bool isLeaf(const int i) const;
+
+  /**
+   * Get the left child of an internal node.
+   *
+   * @param i Node index.
+   */
+  int getLeft(const int i) const;
+
+  /**
+   * Get the right child of an internal node.
+   *
+   * @param i Node index.
+   */
+  int getRight(const int i) const;
+
+  /**
+   * Get the index of the first sample of a node, in the reordered samples.
+   *
+   * @param i Node index.
+   */
+  int getStart(const int i) const;
+
+  /**
+   * Get the index of one past the last sample of a node, in the reordered
+   * samples.
+   *
+   * @param i Node index.
+   */
+  int getEnd(const int i) const;
+
+  /**
+   * Get lower bound on a node.
+   *
+   * @param i Node index.
+   */
+  const typename M1::vector_reference_type getLower(const int i) const;
+
+  /**
+   * Get upper bound on a node.
+   *
+   * @param i Node index.
+   */
+  const typename M1::vector_reference_type getUpper(const int i) const;
+
+  /**
+   * Get reordered samples. Columns index samples, rows index variables.
+   */
+  const typename M1::matrix_reference_type getValues() const;
+
+  /**
+   * Get reordered log-weights.
+   */
+  const typename V1::vector_reference_type getLogWeights() const;
+
+  /**
+   * Get log of the total weight of the samples of a node.
+   *
+   * @param i Node index.
+   */
+  real getNodeLogWeight(const int i) const;
+
+  /**
+   * Get indices of reordered samples into the original sample set.
+   */
+  const host_vector<int>& getIndices() const;
+
+  /**
+   * Find the coordinate difference of a node from a node of another tree.
+   *
+   * @tparam V2 Vector type.
+   * @tparam M2 Matrix type.
+   * @tparam V3 Vector type.
+   *
+   * @param i Node index in this tree.
+   * @param o Other tree.
+   * @param j Node index in other tree.
+   * @param[out] result Difference between the closest two points in the
+   * volumes contained by the nodes.
+   */
+  template<class V2, class M2, class V3>
+  void difference(const int i, const FlatKDTree<V2,M2>& o, const int j,
+      V3 result) const;
+
+  /**
+   * Find the coordinate difference of a node from a point.
+   *
+   * @tparam V2 Vector type.
+   * @tparam V3 Vector type.
+   *
+   * @param i Node index.
+   * @param x Point.
+   * @param[out] result Difference between @p x and the closest point in the
+   * volume contained by the node.
+   */
+  template<class V2, class V3>
+  void difference(const int i, const V2 x, V3 result) const;
+
+  /**
+   * Find the coordinate difference of the farthest point in the volume
+   * contained by a node from a point.
+   *
+   * @tparam V2 Vector type.
+   * @tparam V3 Vector type.
+   *
+   * @param i Node index.
+   * @param x Point.
+   * @param[out] result Difference between @p x and the farthest point in
+   * the volume contained by the node.
+   */
+  template<class V2, class V3>
+  void farDifference(const int i, const V2 x, V3 result) const;
+
+  /**
+   * Find the coordinate difference of the farthest two points in the
+   * volumes contained by a node and a node of another tree.
+   *
+   * @tparam V2 Vector type.
+   * @tparam M2 Matrix type.
+   * @tparam V3 Vector type.
+   *
+   * @param i Node index in this tree.
+   * @param o Other tree.
+   * @param j Node index in other tree.
+   * @param[out] result Difference between the farthest two points in the
+   * volumes contained by the nodes.
+   */
+  template<class V2, class M2, class V3>
+  void farDifference(const int i, const FlatKDTree<V2,M2>& o, const int j,
+      V3 result) const;
+
+private:
+  /**
+   * Build tree.
+   */
+  template<class M2, class V2>
+  void build(const M2 X, const V2 lw, const int leafSize);
+
+  /**
+   * Reordered samples, one per column.
+   */
+  M1 X;
+
+  /**
+   * Reordered log-weights.
+   */
+  V1 lw;
+
+  /**
+   * Log of total weight of each node.
+   */
+  V1 nodeLw;
+
+  /**
+   * Lower bounds of nodes, one per column.
+   */
+  M1 lower;
+
+  /**
+   * Upper bounds of nodes, one per column.
+   */
+  M1 upper;
+
+  /**
+   * Indices of reordered samples into original sample set.
+   */
+  host_vector<int> is;
+
+  /**
+   * Index of first sample of each node.
+   */
+  host_vector<int> starts;
+
+  /**
+   * Index of one past last sample of each node.
+   */
+  host_vector<int> ends;
+
+  /**
+   * Depth of the tree.
+   */
+  int depth;
+
+  #ifndef __CUDACC__
+  /**
+   * Serialize.
+   */
+  template<class Archive>
+  void save(Archive& ar, const int version) const;
+
+  /**
+   * Restore from serialization.
+   */
+  template<class Archive>
+  void load(Archive& ar, const int version);
+
+  /*
+   * Boost.Serialization requirements.
+   */
+  BOOST_SERIALIZATION_SPLIT_MEMBER()
+  friend class boost::serialization::access;
+  #endif
+};
+
+/**
+ * @internal
+ *
+ * Compares sample indices by the value of one variable.
+ */
+template<class M1>
+struct flat_kd_tree_less {
+  flat_kd_tree_less(const M1 X, const int j) :
+      X(X), j(j) {
+    //
+  }
+
+  bool operator()(const int a, const int b) const {
+    return X(a, j) < X(b, j);
+  }
+
+  const M1 X;
+  const int j;
+};
+}
+
+#include "../math/view.hpp"
+#include "../math/constant.hpp"
+#include "../math/temp_vector.hpp"
+#include "../primitive/vector_primitive.hpp"
+
+#include <algorithm>
+
+template<class V1, class M1>
+bi::FlatKDTree<V1,M1>::FlatKDTree() :
+    depth(0) {
+  //
+}
+
+template<class V1, class M1>
+template<class M2, class V2>
+bi::FlatKDTree<V1,M1>::FlatKDTree(const M2 X, const V2 lw,
+    const int leafSize) :
+    depth(0) {
+  build(X, lw, leafSize);
+}
+
+template<class V1, class M1>
+template<class M2>
+bi::FlatKDTree<V1,M1>::FlatKDTree(const M2 X, const int leafSize) :
+    depth(0) {
+  typename temp_host_vector<real>::type lw(X.size1());
+  lw.clear();
+  build(X, lw, leafSize);
+}
+
+template<class V1, class M1>
+inline int bi::FlatKDTree<V1,M1>::getSize() const {
+  return X.size1();
+}
+
+template<class V1, class M1>
+inline int bi::FlatKDTree<V1,M1>::getCount() const {
+  return X.size2();
+}
+
+template<class V1, class M1>
+inline int bi::FlatKDTree<V1,M1>::getNumNodes() const {
+  return starts.size();
+}
+
+template<class V1, class M1>
+inline int bi::FlatKDTree<V1,M1>::getDepth() const {
+  return depth;
+}
+
+template<class V1, class M1>
+inline bool bi::FlatKDTree<V1,M1>::isLeaf(const int i) const {
+  return i >= (1 << depth) - 1;
+}
+
+template<class V1, class M1>
+inline int bi::FlatKDTree<V1,M1>::getLeft(const int i) const {
+  /* pre-condition */
+  BI_ASSERT(!isLeaf(i));
+
+  return 2 * i + 1;
+}
+
+template<class V1, class M1>
+inline int bi::FlatKDTree<V1,M1>::getRight(const int i) const {
+  /* pre-condition */
+  BI_ASSERT(!isLeaf(i));
+
+  return 2 * i + 2;
+}
+
+template<class V1, class M1>
+inline int bi::FlatKDTree<V1,M1>::getStart(const int i) const {
+  return starts(i);
+}
+
+template<class V1, class M1>
+inline int bi::FlatKDTree<V1,M1>::getEnd(const int i) const {
+  return ends(i);
+}
+
+template<class V1, class M1>
+inline const typename M1::vector_reference_type bi::FlatKDTree<V1,M1>::getLower(
+    const int i) const {
+  return column(lower, i);
+}
+
+template<class V1, class M1>
+inline const typename M1::vector_reference_type bi::FlatKDTree<V1,M1>::getUpper(
+    const int i) const {
+  return column(upper, i);
+}
+
+template<class V1, class M1>
+inline const typename M1::matrix_reference_type bi::FlatKDTree<V1,M1>::getValues() const {
+  return X;
+}
+
+template<class V1, class M1>
+inline const typename V1::vector_reference_type bi::FlatKDTree<V1,M1>::getLogWeights() const {
+  return lw;
+}
+
+template<class V1, class M1>
+inline real bi::FlatKDTree<V1,M1>::getNodeLogWeight(const int i) const {
+  return nodeLw(i);
+}
+
+template<class V1, class M1>
+inline const bi::host_vector<int>& bi::FlatKDTree<V1,M1>::getIndices() const {
+  return is;
+}
+
+template<class V1, class M1>
+template<class V2, class M2, class V3>
+inline void bi::FlatKDTree<V1,M1>::difference(const int i,
+    const FlatKDTree<V2,M2>& o, const int j, V3 result) const {
+  /* pre-condition */
+  BI_ASSERT(o.getSize() == getSize());
+  BI_ASSERT(result.size() == getSize());
+
+  BOOST_AUTO(lower1, getLower(i));
+  BOOST_AUTO(upper1, getUpper(i));
+  BOOST_AUTO(lower2, o.getLower(j));
+  BOOST_AUTO(upper2, o.getUpper(j));
+
+  for (int k = 0; k < result.size(); ++k) {
+    if (upper2(k) < lower1(k)) {
+      result(k) = lower1(k) - upper2(k);
+    } else if (lower2(k) > upper1(k)) {
+      result(k) = lower2(k) - upper1(k);
+    } else {
+      result(k) = 0.0;
+    }
+  }
+}
+
+template<class V1, class M1>
+template<class V2, class M2, class V3>
+inline void bi::FlatKDTree<V1,M1>::farDifference(const int i,
+    const FlatKDTree<V2,M2>& o, const int j, V3 result) const {
+  /* pre-condition */
+  BI_ASSERT(o.getSize() == getSize());
+  BI_ASSERT(result.size() == getSize());
+
+  BOOST_AUTO(lower1, getLower(i));
+  BOOST_AUTO(upper1, getUpper(i));
+  BOOST_AUTO(lower2, o.getLower(j));
+  BOOST_AUTO(upper2, o.getUpper(j));
+
+  for (int k = 0; k < result.size(); ++k) {
+    result(k) = bi::max(upper1(k) - lower2(k), upper2(k) - lower1(k));
+  }
+}
+
+template<class V1, class M1>
+template<class V2, class V3>
+inline void bi::FlatKDTree<V1,M1>::difference(const int i, const V2 x,
+    V3 result) const {
+  /* pre-condition */
+  BI_ASSERT(x.size() == getSize());
+  BI_ASSERT(result.size() == getSize());
+
+  BOOST_AUTO(lower, getLower(i));
+  BOOST_AUTO(upper, getUpper(i));
+
+  for (int k = 0; k < result.size(); ++k) {
+    if (x(k) < lower(k)) {
+      result(k) = lower(k) - x(k);
+    } else if (x(k) > upper(k)) {
+      result(k) = x(k) - upper(k);
+    } else {
+      result(k) = 0.0;
+    }
+  }
+}
+
+template<class V1, class M1>
+template<class V2, class V3>
+inline void bi::FlatKDTree<V1,M1>::farDifference(const int i, const V2 x,
+    V3 result) const {
+  /* pre-condition */
+  BI_ASSERT(x.size() == getSize());
+  BI_ASSERT(result.size() == getSize());
+
+  BOOST_AUTO(lower, getLower(i));
+  BOOST_AUTO(upper, getUpper(i));
+
+  for (int k = 0; k < result.size(); ++k) {
+    result(k) = bi::max(upper(k) - x(k), x(k) - lower(k));
+  }
+}
+
+template<class V1, class M1>
+template<class M2, class V2>
+void bi::FlatKDTree<V1,M1>::build(const M2 X, const V2 lw,
+    const int leafSize) {
+  /* pre-conditions */
+  BI_ASSERT(X.size1() == lw.size());
+  BI_ASSERT(leafSize > 0);
+  BI_ASSERT(!M2::on_device);
+
+  const int P = X.size1();
+  const int N = X.size2();
+
+  /* smallest depth at which leaves hold no more than leafSize samples */
+  depth = 0;
+  while (((P + (1 << depth) - 1) >> depth) > leafSize) {
+    ++depth;
+  }
+  const int nnodes = (1 << (depth + 1)) - 1;
+
+  std::vector<int> perm(P);
+  for (int p = 0; p < P; ++p) {
+    perm[p] = p;
+  }
+  this->X.resize(N, P);
+  this->lw.resize(P);
+  nodeLw.resize(nnodes);
+  lower.resize(N, nnodes);
+  upper.resize(N, nnodes);
+  is.resize(P);
+  starts.resize(nnodes);
+  ends.resize(nnodes);
+  starts(0) = 0;
+  ends(0) = P;
+
+  /* build level by level; nodes on the same level cover disjoint ranges of
+   * samples, so may be built in parallel */
+  for (int level = 0; level <= depth; ++level) {
+    const int first = (1 << level) - 1;
+    const int last = (1 << (level + 1)) - 1;
+
+    #pragma omp parallel for
+    for (int i = first; i < last; ++i) {
+      const int start = starts(i), end = ends(i);
+      BOOST_AUTO(lo, column(lower, i));
+      BOOST_AUTO(hi, column(upper, i));
+      int j, k, longest = 0;
+      real x, maxlen = 0.0;
+
+      /* bounding box */
+      set_elements(lo, BI_INF);
+      set_elements(hi, -BI_INF);
+      for (k = start; k < end; ++k) {
+        for (j = 0; j < N; ++j) {
+          x = X(perm[k], j);
+          lo(j) = bi::min(lo(j), x);
+          hi(j) = bi::max(hi(j), x);
+        }
+      }
+
+      /* split on median of dimension with greatest range */
+      if (level < depth) {
+        for (j = 0; j < N; ++j) {
+          if (hi(j) - lo(j) > maxlen) {
+            maxlen = hi(j) - lo(j);
+            longest = j;
+          }
+        }
+        const int median = start + (end - start) / 2;
+        std::nth_element(perm.begin() + start, perm.begin() + median,
+            perm.begin() + end, flat_kd_tree_less<M2>(X, longest));
+
+        starts(getLeft(i)) = start;
+        ends(getLeft(i)) = median;
+        starts(getRight(i)) = median;
+        ends(getRight(i)) = end;
+      }
+    }
+  }
+
+  /* reorder samples so that each node's are contiguous */
+  for (int p = 0; p < P; ++p) {
+    is(p) = perm[p];
+    column(this->X, p) = row(X, perm[p]);
+    this->lw(p) = lw(perm[p]);
+  }
+
+  /* total weight of each node, for pruning */
+  #pragma omp parallel for
+  for (int i = 0; i < nnodes; ++i) {
+    if (ends(i) > starts(i)) {
+      nodeLw(i) = logsumexp_reduce(subrange(this->lw, starts(i),
+          ends(i) - starts(i)));
+    } else {
+      nodeLw(i) = -BI_INF;
+    }
+  }
+}
+
+#ifndef __CUDACC__
+template<class V1, class M1>
+template<class Archive>
+void bi::FlatKDTree<V1,M1>::save(Archive& ar, const int version) const {
+  ar & depth;
+  ar & X;
+  ar & lw;
+  ar & nodeLw;
+  ar & lower;
+  ar & upper;
+  ar & is;
+  ar & starts;
+  ar & ends;
+}
+
+template<class V1, class M1>
+template<class Archive>
+void bi::FlatKDTree<V1,M1>::load(Archive& ar, const int version) {
+  ar & depth;
+  ar & X;
+  ar & lw;
+  ar & nodeLw;
+  ar & lower;
+  ar & upper;
+  ar & is;
+  ar & starts;
+  ar & ends;
+}
+#endif
+
+#endif
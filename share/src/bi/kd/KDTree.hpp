@@ -144,6 +144,8 @@ private:
 
 #include "partition.hpp"
 
+#include <vector>
+
 template<class V1, class M1>
 bi::KDTree<V1,M1>::KDTree() : root(NULL) {
   //
@@ -152,8 +154,10 @@ bi::KDTree<V1,M1>::KDTree() : root(NULL) {
 template<class V1, class M1>
 template<class M2, class V2, class S1>
 bi::KDTree<V1,M1>::KDTree(const M2 X, const V2 lw, const S1 partitioner) {
-  host_vector<int> is(X.size1());
-  seq_elements(is, 0);
+  std::vector<int> is(X.size1());
+  for (int i = 0; i < (int)is.size(); ++i) {
+    is[i] = i;
+  }
 
   root = (is.size() > 0) ? build(X, lw, partitioner, is) : NULL;
 }
@@ -163,8 +167,10 @@ template<class M2, class S1>
 bi::KDTree<V1,M1>::KDTree(const M2 X, const S1 partitioner) {
   V1 lw(X.size1());
   lw.clear();
-  host_vector<int> is(X.size1());
-  seq_elements(is, 0);
+  std::vector<int> is(X.size1());
+  for (int i = 0; i < (int)is.size(); ++i) {
+    is[i] = i;
+  }
 
   root = (is.size() > 0) ? build(X, lw, partitioner, is) : NULL;
 }
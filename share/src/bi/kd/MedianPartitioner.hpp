@@ -50,8 +50,11 @@ private:
 };
 }
 
+#include "../math/temp_vector.hpp"
 #include "../primitive/vector_primitive.hpp"
 
+#include <algorithm>
+
 template<class M1, class V1>
 bool bi::MedianPartitioner::init(const M1 X, const V1 is) {
   /* pre-condition */
@@ -77,7 +80,9 @@ bool bi::MedianPartitioner::init(const M1 X, const V1 is) {
 
   /* split on median of selected dimension */
   temp_host_vector<real>::type values(is.size());
-  bi::gather(is, column(X,longest), values);
+  for (i = 0; i < (int)is.size(); ++i) {
+    values(i) = X(is[i], longest);
+  }
   int median = values.size()/2;
   std::nth_element(values.begin(), values.begin() + median, values.end());
 
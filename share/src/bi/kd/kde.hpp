@@ -13,6 +13,7 @@
 #define BI_KD_KDE_HPP
 
 #include "KDTree.hpp"
+#include "FlatKDTree.hpp"
 
 namespace bi {
 /**
@@ -60,6 +61,72 @@ template<class V1, class M1, class V2, class M2, class K1, class V3>
 void dualTreeDensity(KDTree<V1,M1>& queryTree, KDTree<V2,M2>& targetTree,
     const K1& K, V3 p, const bool clear = true);
 
+/**
+ * Dual-tree kernel density evaluation over flat trees.
+ *
+ * @ingroup kd
+ *
+ * @tparam V1 Vector type.
+ * @tparam M1 Matrix type.
+ * @tparam V2 Vector type.
+ * @tparam M2 Matrix type.
+ * @tparam K1 Kernel type.
+ * @tparam V3 Vector type.
+ *
+ * @param queryTree Query tree.
+ * @param targetTree Target tree.
+ * @param K Kernel.
+ * @param[out] p Vector of the density estimates for each of the points in
+ * @p queryTree, in their original order.
+ * @param clear Clear @p p before computations?
+ * @param eps Error tolerance, relative to the maximum of the kernel times
+ * the total weight of @p targetTree.
+ *
+ * The traversal is first expanded breadth-first into a set of independent
+ * node pairs, several per thread, which are then traversed in parallel.
+ * Each thread accumulates into its own vector, and these are summed at the
+ * end, so that no locking is required.
+ *
+ * A pair of nodes is pruned when the kernel at the closest distance between
+ * them, times the weight of the target node, falls below the tolerance. Its
+ * contribution to each query point is then taken as the weight of the
+ * target node times the mean of the kernel at the closest and farthest
+ * distances, with error no more than half the tolerance. Distant pairs are
+ * so pruned, rather than evaluated point by point.
+ */
+template<class V1, class M1, class V2, class M2, class K1, class V3>
+void dualTreeDensity(const FlatKDTree<V1,M1>& queryTree,
+    const FlatKDTree<V2,M2>& targetTree, const K1& K, V3 p,
+    const bool clear = true, const real eps = 1.0e-8);
+
+/**
+ * Single-tree kernel density evaluation at one point, over a flat tree.
+ *
+ * @ingroup kd
+ *
+ * @tparam V1 Vector type.
+ * @tparam V2 Vector type.
+ * @tparam M2 Matrix type.
+ * @tparam K1 Kernel type.
+ *
+ * @param x Query point.
+ * @param targetTree Target tree.
+ * @param K Kernel.
+ * @param eps Error tolerance, as for #dualTreeDensity.
+ *
+ * @return Density estimate at @p x.
+ *
+ * Nodes are pruned as in #dualTreeDensity. With @p eps of zero, a node is
+ * pruned only when the kernel bound underflows, so that the result is
+ * exact. The traversal is serial; it is intended for evaluating a handful
+ * of points, such as the two states of a Metropolis-Hastings proposal, for
+ * which building a query tree and dividing work between threads costs more
+ * than the evaluation itself.
+ */
+template<class V1, class V2, class M2, class K1>
+real singleTreeDensity(const V1 x, const FlatKDTree<V2,M2>& targetTree,
+    const K1& K, const real eps = 1.0e-8);
+
 /**
  * Self-tree kernel density evaluation.
  *
@@ -118,8 +185,15 @@ void dualTreeDensity(KDTree<V1,M1>& queryTree, KDTree<V2,M2>& targetTree,
 #include "../math/sim_temp_vector.hpp"
 #include "../math/sim_temp_matrix.hpp"
 
+#include "../math/view.hpp"
+#include "../math/operation.hpp"
+#include "../primitive/matrix_primitive.hpp"
+#include "../misc/omp.hpp"
+
 #include <list>
 #include <stack>
+#include <vector>
+#include <utility>
 
 inline double bi::hopt(const int N, const int P) {
   return std::pow(4.0 / ((N + 2) * P), 1.0 / (N + 4));
@@ -149,7 +223,7 @@ void bi::dualTreeDensity(KDTree<V1,M1>& queryTree, KDTree<V2,M2>& targetTree,
     queryNodes1.push_back(queryRoot);
     targetVars1.push_back(targetRoot);
 
-    sim_temp_vector<M1> x(queryTree.getSize());
+    typename sim_temp_vector<M1>::type x(queryTree.getSize());
     bool done = false;
 #if defined(ENABLE_OPENMP) and defined(HAVE_OMP_H)
     while (!done && (int)queryNodes1.size() < 64*omp_get_max_threads()) {
@@ -162,8 +236,8 @@ void bi::dualTreeDensity(KDTree<V1,M1>& queryTree, KDTree<V2,M2>& targetTree,
       done = queryNode == NULL || !queryNode->isInternal()
           || targetVar == NULL || !targetVar->isInternal();
       if (!done) {
-        targetVar->difference(*queryNode, *x);
-        if (K(*x) > 0.0) {
+        targetVar->difference(*queryNode, x);
+        if (K(x) > 0.0) {
           queryNodes1.push_back(queryNode->getLeft());
           targetVars1.push_back(targetVar->getLeft());
 
@@ -205,7 +279,7 @@ void bi::dualTreeDensity(KDTree<V1,M1>& queryTree, KDTree<V2,M2>& targetTree,
 #if defined(ENABLE_OPENMP) and defined(HAVE_OMP_H)
       omp_set_lock (&lock);
 #endif
-      sim_temp_vector<M1> x1(queryTree.getSize());
+      typename sim_temp_vector<M1>::type x1(queryTree.getSize());
 #if defined(ENABLE_OPENMP) and defined(HAVE_OMP_H)
       omp_unset_lock(&lock);
 #endif
@@ -320,6 +394,183 @@ void bi::dualTreeDensity(KDTree<V1,M1>& queryTree, KDTree<V2,M2>& targetTree,
   }
 }
 
+template<class V1, class M1, class V2, class M2, class K1, class V3>
+void bi::dualTreeDensity(const FlatKDTree<V1,M1>& queryTree,
+    const FlatKDTree<V2,M2>& targetTree, const K1& K, V3 p,
+    const bool clear, const real eps) {
+  /* pre-conditions */
+  BI_ASSERT(queryTree.getSize() == targetTree.getSize());
+  BI_ASSERT(p.size() == queryTree.getCount());
+  BI_ASSERT(!V3::on_device);
+
+  typedef std::pair<int,int> pair_type;
+
+  if (clear) {
+    p.clear();
+  }
+  if (queryTree.getCount() > 0 && targetTree.getCount() > 0) {
+    const int N = queryTree.getSize();
+    std::vector<pair_type> pairs, pairs1;
+    typename temp_host_vector<real>::type x(N);
+    bool done = false;
+
+    /* pruning threshold on the kernel times the weight of a target node */
+    x.clear();
+    const real tol = eps * K(x) * bi::exp(targetTree.getNodeLogWeight(0));
+
+    /* expand breadth first to build a work set of independent node pairs
+     * for division between threads */
+    pairs.push_back(pair_type(0, 0));
+    while (!done && (int)pairs.size() < 64 * bi_omp_max_threads) {
+      done = true;
+      pairs1.clear();
+      for (int k = 0; k < (int)pairs.size(); ++k) {
+        const int i = pairs[k].first, j = pairs[k].second;
+        const bool queryLeaf = queryTree.isLeaf(i);
+        const bool targetLeaf = targetTree.isLeaf(j);
+
+        queryTree.difference(i, targetTree, j, x);
+        if ((queryLeaf && targetLeaf) ||
+            K(x) * bi::exp(targetTree.getNodeLogWeight(j)) <= tol) {
+          pairs1.push_back(pairs[k]);
+        } else {
+          done = false;
+          if (!queryLeaf && !targetLeaf) {
+            pairs1.push_back(pair_type(queryTree.getLeft(i), targetTree.getLeft(j)));
+            pairs1.push_back(pair_type(queryTree.getLeft(i), targetTree.getRight(j)));
+            pairs1.push_back(pair_type(queryTree.getRight(i), targetTree.getLeft(j)));
+            pairs1.push_back(pair_type(queryTree.getRight(i), targetTree.getRight(j)));
+          } else if (!queryLeaf) {
+            pairs1.push_back(pair_type(queryTree.getLeft(i), j));
+            pairs1.push_back(pair_type(queryTree.getRight(i), j));
+          } else {
+            pairs1.push_back(pair_type(i, targetTree.getLeft(j)));
+            pairs1.push_back(pair_type(i, targetTree.getRight(j)));
+          }
+        }
+      }
+      pairs.swap(pairs1);
+    }
+
+    /* traverse in parallel, accumulating into per-thread columns, in the
+     * order of the reordered query points for locality */
+    typename temp_host_matrix<real>::type Q(queryTree.getCount(),
+        bi_omp_max_threads);
+    typename temp_host_vector<real>::type q(queryTree.getCount());
+    Q.clear();
+
+    #pragma omp parallel
+    {
+      typename temp_host_vector<real>::type x(N);
+      BOOST_AUTO(Xq, queryTree.getValues());
+      BOOST_AUTO(Xt, targetTree.getValues());
+      BOOST_AUTO(lwt, targetTree.getLogWeights());
+      BOOST_AUTO(accum, column(Q, bi_omp_tid));
+      std::vector<pair_type> stack;
+      real a, w;
+
+      // static schedule, so that floating point sums are reproducible
+      #pragma omp for schedule(static, 1)
+      for (int k = 0; k < (int)pairs.size(); ++k) {
+        stack.push_back(pairs[k]);
+        while (!stack.empty()) {
+          const int i = stack.back().first, j = stack.back().second;
+          const bool queryLeaf = queryTree.isLeaf(i);
+          const bool targetLeaf = targetTree.isLeaf(j);
+          stack.pop_back();
+
+          queryTree.difference(i, targetTree, j, x);
+          w = bi::exp(targetTree.getNodeLogWeight(j));
+          a = K(x) * w;
+          if (a <= tol) {
+            /* prune, approximating the kernel by the mean of its bounds */
+            queryTree.farDifference(i, targetTree, j, x);
+            a = 0.5 * (a + K(x) * w);
+            for (int u = queryTree.getStart(i); u < queryTree.getEnd(i); ++u) {
+              accum(u) += a;
+            }
+          } else if (queryLeaf && targetLeaf) {
+            for (int u = queryTree.getStart(i); u < queryTree.getEnd(i); ++u) {
+              a = 0.0;
+              for (int v = targetTree.getStart(j); v < targetTree.getEnd(j); ++v) {
+                x = column(Xq, u);
+                axpy(-1.0, column(Xt, v), x);
+                a += bi::exp(lwt(v) + K.logDensity(x));
+              }
+              accum(u) += a;
+            }
+          } else if (!queryLeaf && !targetLeaf) {
+            stack.push_back(pair_type(queryTree.getLeft(i), targetTree.getLeft(j)));
+            stack.push_back(pair_type(queryTree.getLeft(i), targetTree.getRight(j)));
+            stack.push_back(pair_type(queryTree.getRight(i), targetTree.getLeft(j)));
+            stack.push_back(pair_type(queryTree.getRight(i), targetTree.getRight(j)));
+          } else if (!queryLeaf) {
+            stack.push_back(pair_type(queryTree.getLeft(i), j));
+            stack.push_back(pair_type(queryTree.getRight(i), j));
+          } else {
+            stack.push_back(pair_type(i, targetTree.getLeft(j)));
+            stack.push_back(pair_type(i, targetTree.getRight(j)));
+          }
+        }
+      }
+    }
+    sum_columns(Q, q);
+
+    /* restore original order of query points */
+    const host_vector<int>& is = queryTree.getIndices();
+    for (int u = 0; u < q.size(); ++u) {
+      p(is(u)) += q(u);
+    }
+  }
+}
+
+template<class V1, class V2, class M2, class K1>
+real bi::singleTreeDensity(const V1 x, const FlatKDTree<V2,M2>& targetTree,
+    const K1& K, const real eps) {
+  /* pre-conditions */
+  BI_ASSERT(x.size() == targetTree.getSize());
+  BI_ASSERT(!V1::on_device);
+
+  real p = 0.0;
+  if (targetTree.getCount() > 0) {
+    const int N = targetTree.getSize();
+    typename temp_host_vector<real>::type d(N);
+    BOOST_AUTO(Xt, targetTree.getValues());
+    BOOST_AUTO(lwt, targetTree.getLogWeights());
+    std::vector<int> stack;
+    real a, w;
+
+    /* pruning threshold on the kernel times the weight of a target node */
+    d.clear();
+    const real tol = eps * K(d) * bi::exp(targetTree.getNodeLogWeight(0));
+
+    stack.push_back(0);
+    while (!stack.empty()) {
+      const int j = stack.back();
+      stack.pop_back();
+
+      targetTree.difference(j, x, d);
+      w = bi::exp(targetTree.getNodeLogWeight(j));
+      a = K(d) * w;
+      if (a <= tol) {
+        /* prune, approximating the kernel by the mean of its bounds */
+        targetTree.farDifference(j, x, d);
+        p += 0.5 * (a + K(d) * w);
+      } else if (targetTree.isLeaf(j)) {
+        for (int v = targetTree.getStart(j); v < targetTree.getEnd(j); ++v) {
+          d = x;
+          axpy(-1.0, column(Xt, v), d);
+          p += bi::exp(lwt(v) + K.logDensity(d));
+        }
+      } else {
+        stack.push_back(targetTree.getLeft(j));
+        stack.push_back(targetTree.getRight(j));
+      }
+    }
+  }
+  return p;
+}
+
 //template<class M1, class V1, class K1, class V2>
 //void bi::selfTreeDensity(KDTree<V1>& tree, const M1 X, const V1 lw,
 //    const K1& K, V2 p) {
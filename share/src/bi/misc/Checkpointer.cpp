@@ -0,0 +1,55 @@
+/**
+ * @file
+ *
+ * @author Lawrence Murray <lawrence.murray@csiro.au>
+ * $Rev$
+ * $Date$
+ */
+#include "Checkpointer.hpp"
+
+#include <fstream>
+#include <sys/wait.h>
+
+bi::Checkpointer::Checkpointer(const std::string& file, const int interval,
+    const bool resume) :
+    file(file), interval(interval), resume(resume), child(-1) {
+  //
+}
+
+bi::Checkpointer::~Checkpointer() {
+  wait();
+}
+
+bool bi::Checkpointer::isDue(const int c) const {
+  return !file.empty() && interval > 0 && c > 0 && c % interval == 0;
+}
+
+bool bi::Checkpointer::canResume() const {
+  return resume && !file.empty() && std::ifstream(file.c_str()).good();
+}
+
+void bi::Checkpointer::wait() {
+  if (child > 0) {
+    int status = 0;
+    if (waitpid(child, &status, 0) == child) {
+      BI_WARN_MSG(WIFEXITED(status) && WEXITSTATUS(status) == 0,
+          "Could not write checkpoint " << file);
+    }
+    child = -1;
+  }
+}
+
+bool bi::Checkpointer::isBusy() {
+  if (child > 0) {
+    int status = 0;
+    pid_t pid = waitpid(child, &status, WNOHANG);
+    if (pid == 0) {
+      return true;
+    } else if (pid == child) {
+      BI_WARN_MSG(WIFEXITED(status) && WEXITSTATUS(status) == 0,
+          "Could not write checkpoint " << file);
+    }
+    child = -1;
+  }
+  return false;
+}
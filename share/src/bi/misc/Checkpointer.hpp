@@ -0,0 +1,199 @@
+/**
+ * @file
+ *
+ * @author Lawrence Murray <lawrence.murray@csiro.au>
+ * $Rev$
+ * $Date$
+ */
+#ifndef BI_MISC_CHECKPOINTER_HPP
+#define BI_MISC_CHECKPOINTER_HPP
+
+#include <string>
+#include <sys/types.h>
+
+namespace bi {
+/**
+ * Periodic checkpoints of long-running methods, for later resumption.
+ *
+ * @ingroup misc
+ *
+ * A checkpoint is a Boost.Serialization binary archive of the objects given
+ * to #write. Checkpoints are written asynchronously: the process forks, and
+ * the child writes its copy of the objects, as they were at the time of the
+ * fork, while the parent continues. The child writes to a temporary file
+ * and renames it over the checkpoint file on completion, so that the
+ * checkpoint file is always complete. If the previous checkpoint is still
+ * being written when the next is due, the next is skipped.
+ *
+ * With CUDA, state on the device is not duplicated by the fork, and
+ * checkpoints are written synchronously instead. The same applies with
+ * MPI, as many MPI implementations do not support fork, in particular
+ * where memory is registered with the interconnect.
+ *
+ * Only the calling thread is duplicated by the fork. Locks held by other
+ * threads at that time, such as those of the memory allocator, remain
+ * held in the child, and it would deadlock on them. #write must therefore
+ * be called from outside OpenMP parallel regions, when other threads are
+ * idle.
+ */
+class Checkpointer {
+public:
+  /**
+   * Constructor.
+   *
+   * @param file Checkpoint file, empty for none.
+   * @param interval Number of steps between checkpoints, zero for none.
+   * @param resume Resume from an existing checkpoint file, if any?
+   */
+  Checkpointer(const std::string& file = "", const int interval = 0,
+      const bool resume = false);
+
+  /**
+   * Destructor. Waits for any checkpoint still being written.
+   */
+  ~Checkpointer();
+
+  /**
+   * Is a checkpoint due?
+   *
+   * @param c Number of steps taken.
+   */
+  bool isDue(const int c) const;
+
+  /**
+   * Is there a checkpoint from which to resume, and should it be resumed?
+   */
+  bool canResume() const;
+
+  /**
+   * Write checkpoint. Must not be called from within an OpenMP parallel
+   * region.
+   *
+   * @tparam T1 Serializable type.
+   * @tparam T2 Serializable type.
+   * @tparam T3 Serializable type.
+   *
+   * @param o1 First object.
+   * @param o2 Second object.
+   * @param o3 Third object.
+   */
+  template<class T1, class T2, class T3>
+  void write(const T1& o1, const T2& o2, const T3& o3);
+
+  /**
+   * Read checkpoint.
+   *
+   * @tparam T1 Serializable type.
+   * @tparam T2 Serializable type.
+   * @tparam T3 Serializable type.
+   *
+   * @param[out] o1 First object.
+   * @param[out] o2 Second object.
+   * @param[out] o3 Third object.
+   *
+   * The objects must be given in the same order as to #write.
+   */
+  template<class T1, class T2, class T3>
+  void read(T1& o1, T2& o2, T3& o3);
+
+  /**
+   * Wait for any checkpoint still being written.
+   */
+  void wait();
+
+private:
+  /**
+   * Is a checkpoint still being written? Reaps the writing process if it
+   * has finished.
+   */
+  bool isBusy();
+
+  /**
+   * Write checkpoint synchronously.
+   *
+   * @return True on success, false otherwise.
+   */
+  template<class T1, class T2, class T3>
+  bool save(const T1& o1, const T2& o2, const T3& o3) const;
+
+  /**
+   * Checkpoint file.
+   */
+  std::string file;
+
+  /**
+   * Number of steps between checkpoints.
+   */
+  int interval;
+
+  /**
+   * Resume from an existing checkpoint file?
+   */
+  bool resume;
+
+  /**
+   * Id of process writing checkpoint, -1 if none.
+   */
+  pid_t child;
+};
+}
+
+#include "assert.hpp"
+
+#include "boost/archive/binary_oarchive.hpp"
+#include "boost/archive/binary_iarchive.hpp"
+
+#include <fstream>
+#include <cstdio>
+#include <unistd.h>
+
+template<class T1, class T2, class T3>
+void bi::Checkpointer::write(const T1& o1, const T2& o2, const T3& o3) {
+  /* pre-condition */
+  BI_ASSERT(!file.empty());
+
+  if (isBusy()) {
+    BI_WARN_MSG(false, "Checkpoint " << file <<
+        " still being written, skipping");
+    return;
+  }
+
+#if defined(ENABLE_CUDA) || defined(ENABLE_MPI)
+  pid_t pid = -1;
+#else
+  pid_t pid = fork();
+#endif
+  if (pid == 0) {
+    /* child, exits without destructors, which would otherwise close files
+     * shared with the parent */
+    _exit(save(o1, o2, o3) ? 0 : 1);
+  } else if (pid > 0) {
+    child = pid;
+  } else {
+    bool success = save(o1, o2, o3);
+    BI_WARN_MSG(success, "Could not write checkpoint " << file);
+  }
+}
+
+template<class T1, class T2, class T3>
+void bi::Checkpointer::read(T1& o1, T2& o2, T3& o3) {
+  std::ifstream stream(file.c_str(), std::ios::binary);
+  BI_ERROR_MSG(stream.good(), "Could not read checkpoint " << file);
+  boost::archive::binary_iarchive ar(stream);
+  ar >> o1 >> o2 >> o3;
+}
+
+template<class T1, class T2, class T3>
+bool bi::Checkpointer::save(const T1& o1, const T2& o2, const T3& o3) const {
+  std::string tmp = file + ".tmp";
+  std::ofstream stream(tmp.c_str(), std::ios::binary);
+  {
+    boost::archive::binary_oarchive ar(stream);
+    ar << o1 << o2 << o3;
+  }
+  stream.close();
+
+  return !stream.fail() && std::rename(tmp.c_str(), file.c_str()) == 0;
+}
+
+#endif
@@ -7,6 +7,7 @@
 #define BI_MPI_ADAPTER_DISTRIBUTEDADAPTER_HPP
 
 #include "../../adapter/Adapter.hpp"
+#include "../../misc/macro.hpp"
 
 namespace bi {
 /**
@@ -17,24 +18,13 @@ namespace bi {
 template<class A>
 class DistributedAdapter: public Adapter<A> {
 public:
-  /**
-   * Constructor.
-   */
-  DistributedAdapter(const bool local = false, const double scale = 0.25,
-      const double essRel = 0.25);
+  BI_PASSTHROUGH_CONSTRUCTORS(DistributedAdapter, Adapter<A>)
 
   template<class S1>
   bool adapt(const S1& s);
 };
 }
 
-template<class A>
-bi::DistributedAdapter<A>::DistributedAdapter(const bool local,
-    const double scale, const double essRel) :
-    Adapter<A>(local, scale, essRel) {
-  //
-}
-
 template<class A>
 template<class S1>
 bool bi::DistributedAdapter<A>::adapt(const S1& s) {
@@ -10,3 +10,15 @@ boost::shared_ptr<bi::DistributedAdapter<bi::GaussianAdapter> > bi::DistributedA
   return boost::make_shared < DistributedAdapter<GaussianAdapter>
       > (local, scale, essRel);
 }
+
+boost::shared_ptr<bi::DistributedAdapter<bi::KernelAdapter> > bi::DistributedAdapterFactory::createKernelAdapter(
+    const bool local, const double scale, const double essRel) {
+  return boost::make_shared < DistributedAdapter<KernelAdapter>
+      > (local, scale, essRel);
+}
+
+boost::shared_ptr<bi::DistributedAdapter<bi::MixtureAdapter> > bi::DistributedAdapterFactory::createMixtureAdapter(
+    const bool local, const double scale, const double essRel, const int K) {
+  return boost::make_shared < DistributedAdapter<MixtureAdapter>
+      > (local, scale, essRel, K);
+}
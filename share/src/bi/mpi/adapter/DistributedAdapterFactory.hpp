@@ -8,6 +8,8 @@
 
 #include "DistributedAdapter.hpp"
 #include "../../adapter/GaussianAdapter.hpp"
+#include "../../adapter/KernelAdapter.hpp"
+#include "../../adapter/MixtureAdapter.hpp"
 
 #include "boost/shared_ptr.hpp"
 #include "boost/make_shared.hpp"
@@ -26,6 +28,20 @@ public:
   static boost::shared_ptr<DistributedAdapter<GaussianAdapter> > createGaussianAdapter(
       const bool local = false, const double scale = 0.25,
       const double essRel = 0.25);
+
+  /**
+   * Create kernel density adapter.
+   */
+  static boost::shared_ptr<DistributedAdapter<KernelAdapter> > createKernelAdapter(
+      const bool local = false, const double scale = 1.0,
+      const double essRel = 0.25);
+
+  /**
+   * Create Gaussian mixture adapter.
+   */
+  static boost::shared_ptr<DistributedAdapter<MixtureAdapter> > createMixtureAdapter(
+      const bool local = false, const double scale = 1.0,
+      const double essRel = 0.25, const int K = 0);
 };
 }
 
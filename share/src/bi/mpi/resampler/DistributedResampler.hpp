@@ -187,6 +187,7 @@ bool bi::DistributedResampler<R>::resample(Random& rng,
     offspringToAncestors(column(O, rank), as1);
     permute(as1);
     s.gather(now, as1);
+    s.own();
     set_elements(s.logWeights(), s.logLikelihood);
     this->shuffle(rng, s);
     rotate(s);
@@ -24,11 +24,12 @@ boost::shared_ptr<bi::DistributedResampler<bi::SystematicResampler> > bi::Distri
 }
 
 boost::shared_ptr<bi::DistributedResampler<bi::MetropolisResampler> > bi::DistributedResamplerFactory::createMetropolisResampler(
-    const int B, const double essRel, const bool anytime) {
+    const int B, const double essRel, const bool anytime, const double bias) {
   BOOST_AUTO(resam,
       boost::make_shared < DistributedResampler<MetropolisResampler>
           > (essRel, anytime));
   resam->setSteps(B);
+  resam->setBias(bias);
   return resam;
 }
 
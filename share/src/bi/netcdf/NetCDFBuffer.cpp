@@ -44,3 +44,7 @@ bi::NetCDFBuffer::~NetCDFBuffer() {
 void bi::NetCDFBuffer::clear() {
   //
 }
+
+void bi::NetCDFBuffer::sync() {
+  nc_sync(ncid);
+}
@@ -45,6 +45,11 @@ public:
    */
   void clear();
 
+  /**
+   * Flush all writes so far to disk.
+   */
+  void sync();
+
 protected:
   /**
    * NetCDF file name recorded by constructor. Using this is preferred to the
@@ -28,3 +28,7 @@ void bi::SimulatorNullBuffer::writeLen(const size_t k, const long& len) {
 void bi::SimulatorNullBuffer::writeClock(const long clock) {
   //
 }
+
+void bi::SimulatorNullBuffer::sync() {
+  //
+}
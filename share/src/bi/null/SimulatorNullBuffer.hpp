@@ -92,6 +92,11 @@ public:
    * @param clock Execution time.
    */
   void writeClock(const long clock);
+
+  /**
+   * @copydoc NetCDFBuffer::sync()
+   */
+  void sync();
 };
 }
 
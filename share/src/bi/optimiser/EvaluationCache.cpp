@@ -0,0 +1,91 @@
+/**
+ * @file
+ *
+ * @author Lawrence Murray <lawrence.murray@csiro.au>
+ * $Rev$
+ * $Date$
+ */
+#include "EvaluationCache.hpp"
+
+#include "../misc/assert.hpp"
+#include "../math/misc.hpp"
+
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <cstdio>
+
+bi::EvaluationCache::EvaluationCache(const double resolution,
+    const std::string& file, const std::string& id) :
+    resolution(resolution), file(file), id(id) {
+  /* pre-condition */
+  BI_ASSERT(resolution > 0.0);
+  BI_ASSERT(id.find('\n') == std::string::npos);
+
+  if (!file.empty()) {
+    read();
+  }
+}
+
+int bi::EvaluationCache::size() const {
+  return values.size();
+}
+
+void bi::EvaluationCache::read() {
+  std::ifstream in(file.c_str());
+  if (in.good()) {
+    double resolution1;
+    std::string id1;
+    in >> resolution1 >> std::ws;
+    std::getline(in, id1);
+    if (resolution1 == resolution && id1 == id) {
+      key_type k;
+      double ll;
+      int i, n;
+      while (in >> n) {
+        k.resize(n);
+        for (i = 0; i < n; ++i) {
+          in >> k[i];
+        }
+        in >> ll;
+        if (in.good()) {
+          values[k] = ll;
+        }
+      }
+    } else {
+      BI_WARN_MSG(false, "Evaluation cache " << file <<
+          " written with different resolution or objective, ignoring");
+    }
+  }
+}
+
+void bi::EvaluationCache::write() const {
+  if (!file.empty()) {
+    /* write to temporary file, then rename over the original */
+    std::string tmp = file + ".tmp";
+    std::ofstream out(tmp.c_str());
+    out << std::setprecision(std::numeric_limits<double>::digits10 + 2);
+    out << resolution << std::endl;
+    out << id << std::endl;
+
+    std::map<key_type,double>::const_iterator iter;
+    for (iter = values.begin(); iter != values.end(); ++iter) {
+      /* failed evaluations are cheap to repeat and do not round trip
+       * through text, so are not written */
+      if (bi::is_finite(iter->second)) {
+        const key_type& k = iter->first;
+        out << k.size();
+        for (int i = 0; i < int(k.size()); ++i) {
+          out << ' ' << k[i];
+        }
+        out << ' ' << iter->second << std::endl;
+      }
+    }
+    out.close();
+
+    BI_WARN_MSG(!out.fail(), "Could not write evaluation cache " << tmp);
+    if (!out.fail()) {
+      std::rename(tmp.c_str(), file.c_str());
+    }
+  }
+}
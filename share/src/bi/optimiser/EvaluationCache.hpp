@@ -0,0 +1,168 @@
+/**
+ * @file
+ *
+ * @author Lawrence Murray <lawrence.murray@csiro.au>
+ * $Rev$
+ * $Date$
+ */
+#ifndef BI_OPTIMISER_EVALUATIONCACHE_HPP
+#define BI_OPTIMISER_EVALUATIONCACHE_HPP
+
+#include <map>
+#include <vector>
+#include <string>
+
+namespace bi {
+/**
+ * Cache of evaluations of the log-likelihood for optimisation.
+ *
+ * @ingroup method_optimiser
+ *
+ * Maps parameters, quantised to a given resolution, and the seed of the
+ * random number generator used for the evaluation, to the log-likelihood
+ * there. This is only meaningful when the log-likelihood is a deterministic
+ * function of these, as with ExtendedKF, or a particle filter with common
+ * random numbers; with any other filter, the seed should be fixed and the
+ * cache not used.
+ *
+ * The cache may be read from and written to a file, so that repeated runs
+ * start with the evaluations of previous runs. The file begins with the
+ * resolution and an identification of the objective, such as the model,
+ * observations, filter and number of particles, and its entries are only
+ * used if both match. With common random numbers, entries also only match
+ * if the seed is the same, which across runs requires a fixed seed.
+ *
+ * Lookups and insertions are safe from multiple threads.
+ */
+class EvaluationCache {
+public:
+  /**
+   * Constructor.
+   *
+   * @param resolution Resolution to which parameters are quantised.
+   * @param file File from which to read the cache initially, and to which
+   * to write it with #write. Empty for none.
+   * @param id Identification of the objective, on a single line. The file
+   * is ignored if written with a different identification.
+   */
+  EvaluationCache(const double resolution = 1.0e-8,
+      const std::string& file = "", const std::string& id = "");
+
+  /**
+   * Look up evaluation.
+   *
+   * @tparam V1 Vector type.
+   *
+   * @param x Parameters.
+   * @param seed Seed.
+   * @param[out] ll Log-likelihood, if found.
+   *
+   * @return True if found, false otherwise.
+   */
+  template<class V1>
+  bool get(const V1 x, const unsigned seed, double& ll);
+
+  /**
+   * Insert evaluation.
+   *
+   * @tparam V1 Vector type.
+   *
+   * @param x Parameters.
+   * @param seed Seed.
+   * @param ll Log-likelihood.
+   */
+  template<class V1>
+  void put(const V1 x, const unsigned seed, const double ll);
+
+  /**
+   * Number of evaluations in the cache.
+   */
+  int size() const;
+
+  /**
+   * Write the cache to file, if one was given to the constructor. The file
+   * is replaced atomically, so that an interrupted write does not lose a
+   * previous cache.
+   */
+  void write() const;
+
+private:
+  /**
+   * Key type, the seed followed by the quantised parameters.
+   */
+  typedef std::vector<long long> key_type;
+
+  /**
+   * Construct key.
+   */
+  template<class V1>
+  key_type key(const V1 x, const unsigned seed) const;
+
+  /**
+   * Read the cache from file.
+   */
+  void read();
+
+  /**
+   * Evaluations.
+   */
+  std::map<key_type,double> values;
+
+  /**
+   * Resolution.
+   */
+  double resolution;
+
+  /**
+   * File.
+   */
+  std::string file;
+
+  /**
+   * Identification of the objective.
+   */
+  std::string id;
+};
+}
+
+#include "../math/function.hpp"
+
+template<class V1>
+bool bi::EvaluationCache::get(const V1 x, const unsigned seed, double& ll) {
+  key_type k = key(x, seed);
+  bool found;
+
+  #pragma omp critical(EvaluationCache)
+  {
+    std::map<key_type,double>::const_iterator iter = values.find(k);
+    found = iter != values.end();
+    if (found) {
+      ll = iter->second;
+    }
+  }
+  return found;
+}
+
+template<class V1>
+void bi::EvaluationCache::put(const V1 x, const unsigned seed,
+    const double ll) {
+  key_type k = key(x, seed);
+
+  #pragma omp critical(EvaluationCache)
+  {
+    values[k] = ll;
+  }
+}
+
+template<class V1>
+bi::EvaluationCache::key_type bi::EvaluationCache::key(const V1 x,
+    const unsigned seed) const {
+  key_type k(x.size() + 1);
+  k[0] = seed;
+  for (int i = 0; i < x.size(); ++i) {
+    k[i + 1] = static_cast<long long>(bi::floor(x(i) / resolution + 0.5));
+  }
+  return k;
+}
+
+#endif
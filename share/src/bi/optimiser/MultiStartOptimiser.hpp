@@ -0,0 +1,240 @@
+/**
+ * @file
+ *
+ * @author Lawrence Murray <lawrence.murray@csiro.au>
+ * $Rev$
+ * $Date$
+ */
+#ifndef BI_OPTIMISER_MULTISTARTOPTIMISER_HPP
+#define BI_OPTIMISER_MULTISTARTOPTIMISER_HPP
+
+#include "NelderMeadOptimiser.hpp"
+
+#include "boost/shared_ptr.hpp"
+
+#include <vector>
+
+namespace bi {
+/**
+ * Multi-start Nelder-Mead simplex optimisation.
+ *
+ * @ingroup method_optimiser
+ *
+ * @tparam B Model type
+ * @tparam F #concept::Filter type.
+ *
+ * Runs several NelderMeadOptimiser instances from different starting
+ * points, stepping them in lock step and in parallel, one per thread. Each
+ * has its own filter state and output, and draws from the random number
+ * stream of the thread that runs it. The first starts from the
+ * initialisation file, if any, the others from draws from the prior. Output
+ * at each step is that of the best of the optimisers so far. With common
+ * random numbers, all share the same seed, drawn at the start of
+ * optimisation unless given with #setSeed, so that their evaluations are
+ * comparable, and may be shared through the cache.
+ *
+ * The filter is shared between threads. The first optimiser is initialised
+ * serially, after which the input and observation caches of the filter are
+ * full, and its subsequent use must be safe from multiple threads. This is
+ * the case for all filters but AdaptivePF, which shares the state of its
+ * stopper and resampler between runs.
+ */
+template<class B, class F>
+class MultiStartOptimiser {
+public:
+  /**
+   * Constructor.
+   *
+   * @param m Model.
+   * @param filter Filter.
+   * @param mode Mode of operation.
+   * @param nstarts Number of starting points.
+   * @param crn Use common random numbers for all evaluations?
+   * @param cache Cache of evaluations, shared by all starting points, NULL
+   * for none.
+   */
+  MultiStartOptimiser(B& m, F& filter, const OptimiserMode mode =
+      MAXIMUM_LIKELIHOOD, const int nstarts = 1, const bool crn = false,
+      EvaluationCache* cache = NULL);
+
+  /**
+   * @name High-level interface
+   *
+   * An easier interface for common usage.
+   */
+  //@{
+  /**
+   * Optimise.
+   *
+   * @tparam S State type.
+   * @tparam IO1 Output type.
+   * @tparam IO2 Input type.
+   *
+   * @param[in,out] rng Random number generator.
+   * @param first Start of time schedule.
+   * @param last End of time schedule.
+   * @param[in,out] ss States, one per starting point.
+   * @param out Output buffer.
+   * @param inInit Initialisation file.
+   * @param simplexSizeRel Size of simplex relative to each dimension.
+   * @param stopSteps Maximum number of steps to take.
+   * @param stopSize Size for stopping criterion.
+   */
+  template<class S, class IO1, class IO2>
+  void optimise(Random& rng, const ScheduleIterator first,
+      const ScheduleIterator last, std::vector<S*>& ss, IO1& out,
+      IO2& inInit, const real simplexSizeRel = 0.1, const int stopSteps =
+          100, const real stopSize = 1.0e-4);
+
+  /**
+   * @copydoc NelderMeadOptimiser::setSeed()
+   */
+  void setSeed(const unsigned seed);
+  //@}
+
+private:
+  /**
+   * Index of the optimiser with the best value so far.
+   */
+  int best() const;
+
+  /**
+   * Model.
+   */
+  B& m;
+
+  /**
+   * Optimisers, one per starting point.
+   */
+  std::vector<boost::shared_ptr<NelderMeadOptimiser<B,F> > > optimisers;
+
+  /**
+   * Seed for common random numbers, negative if not yet set.
+   */
+  long seed;
+};
+
+/**
+ * Factory for creating MultiStartOptimiser objects.
+ *
+ * @ingroup method
+ *
+ * @tparam CL Cache location.
+ *
+ * @see MultiStartOptimiser
+ */
+template<Location CL = ON_HOST>
+struct MultiStartOptimiserFactory {
+  /**
+   * Create multi-start Nelder-Mead optimiser.
+   *
+   * @return MultiStartOptimiser object. Caller has ownership.
+   *
+   * @see MultiStartOptimiser::MultiStartOptimiser()
+   */
+  template<class B, class F>
+  static MultiStartOptimiser<B,F>* create(B& m, F& filter,
+      const OptimiserMode mode = MAXIMUM_LIKELIHOOD, const int nstarts = 1,
+      const bool crn = false, EvaluationCache* cache = NULL) {
+    return new MultiStartOptimiser<B,F>(m, filter, mode, nstarts, crn,
+        cache);
+  }
+};
+}
+
+#include "../null/InputNullBuffer.hpp"
+#include "../misc/TicToc.hpp"
+
+#include <limits>
+
+template<class B, class F>
+bi::MultiStartOptimiser<B,F>::MultiStartOptimiser(B& m, F& filter,
+    const OptimiserMode mode, const int nstarts, const bool crn,
+    EvaluationCache* cache) :
+    m(m), optimisers(nstarts), seed(-1) {
+  /* pre-condition */
+  BI_ASSERT(nstarts > 0);
+
+  for (int i = 0; i < nstarts; ++i) {
+    optimisers[i].reset(new NelderMeadOptimiser<B,F>(m, filter, mode, crn,
+        cache));
+  }
+}
+
+template<class B, class F>
+template<class S, class IO1, class IO2>
+void bi::MultiStartOptimiser<B,F>::optimise(Random& rng,
+    const ScheduleIterator first, const ScheduleIterator last,
+    std::vector<S*>& ss, IO1& out, IO2& inInit, const real simplexSizeRel,
+    const int stopSteps, const real stopSize) {
+  /* pre-condition */
+  BI_ASSERT(ss.size() == optimisers.size());
+
+  const int nstarts = optimisers.size();
+  InputNullBuffer inNull(m);
+  std::vector<bool> converged(nstarts, false);
+  TicToc clock;
+  int i, j, k = 0, done = 0;
+
+  if (seed < 0) {
+    seed = rng.uniformInt(0, std::numeric_limits<int>::max());
+  }
+  for (i = 0; i < nstarts; ++i) {
+    optimisers[i]->setSeed(seed);
+  }
+
+  /* the first optimiser fills the input and observation caches of the
+   * filter, the rest can then be initialised in parallel */
+  optimisers[0]->init(rng, first, last, ss[0]->s, ss[0]->out, inInit,
+      simplexSizeRel);
+  #pragma omp parallel for schedule(dynamic)
+  for (i = 1; i < nstarts; ++i) {
+    optimisers[i]->init(rng, first, last, ss[i]->s, ss[i]->out, inNull,
+        simplexSizeRel);
+  }
+
+  while (k < stopSteps && done < nstarts) {
+    #pragma omp parallel for schedule(dynamic)
+    for (i = 0; i < nstarts; ++i) {
+      if (!converged[i]) {
+        optimisers[i]->step();
+      }
+    }
+    for (i = 0; i < nstarts; ++i) {
+      if (!converged[i] && optimisers[i]->hasConverged(stopSize)) {
+        converged[i] = true;
+        ++done;
+      }
+    }
+
+    j = best();
+    optimisers[j]->report(k);
+    optimisers[j]->output(k, ss[j]->s, out);
+    ++k;
+  }
+
+  j = best();
+  ss[j]->clock = clock.toc();
+  out.writeClock(ss[j]->clock);
+  for (i = 0; i < nstarts; ++i) {
+    optimisers[i]->term();
+  }
+}
+
+template<class B, class F>
+inline void bi::MultiStartOptimiser<B,F>::setSeed(const unsigned seed) {
+  this->seed = seed;
+}
+
+template<class B, class F>
+int bi::MultiStartOptimiser<B,F>::best() const {
+  int j = 0;
+  for (int i = 1; i < int(optimisers.size()); ++i) {
+    if (optimisers[i]->getValue() > optimisers[j]->getValue()) {
+      j = i;
+    }
+  }
+  return j;
+}
+
+#endif
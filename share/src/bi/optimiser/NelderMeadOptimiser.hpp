@@ -10,6 +10,8 @@
 
 #include "../state/Schedule.hpp"
 #include "../state/State.hpp"
+#include "../random/Random.hpp"
+#include "EvaluationCache.hpp"
 #include "../math/gsl.hpp"
 
 #include <gsl/gsl_multimin.h>
@@ -81,6 +83,9 @@ struct NelderMeadOptimiserParams {
   IO1* out;
   IO2* in;
   ScheduleIterator first, last;
+  EvaluationCache* cache;
+  bool crn;
+  unsigned seed;
 };
 
 /**
@@ -90,6 +95,16 @@ struct NelderMeadOptimiserParams {
  *
  * @tparam B Model type
  * @tparam F #concept::Filter type.
+ *
+ * With common random numbers enabled, a seed is drawn once at
+ * initialisation, unless given with #setSeed, and a private random number
+ * generator reseeded with it before every evaluation of the objective. The
+ * stream of the calling thread does not depend on its thread number, so
+ * that evaluations give the same result whichever thread makes them. The
+ * likelihood estimate of a particle filter is then a deterministic function
+ * of the parameters, so that comparisons between the vertices of the
+ * simplex are not swamped by Monte Carlo noise, at the cost of optimising
+ * one realisation of that noise.
  */
 template<class B, class F>
 class NelderMeadOptimiser {
@@ -108,10 +123,14 @@ public:
    * @param filter Filter.
    * @param out Output.
    * @param mode Mode of operation.
+   * @param crn Use common random numbers for all evaluations?
+   * @param cache Cache of evaluations, NULL for none.
    *
    * @see BootstrapPF
    */
-  NelderMeadOptimiser(B& m, F& filter, const OptimiserMode mode = MAXIMUM_LIKELIHOOD);
+  NelderMeadOptimiser(B& m, F& filter, const OptimiserMode mode =
+      MAXIMUM_LIKELIHOOD, const bool crn = false,
+      EvaluationCache* cache = NULL);
 
   /**
    * @name High-level interface
@@ -172,6 +191,14 @@ public:
       const ScheduleIterator last, S& s, IO1& out, IO2& inInit,
       const real simplexSizeRel = 0.1);
 
+  /**
+   * Set the seed for common random numbers, rather than drawing one at
+   * initialisation. Used to share one seed between several optimisers.
+   *
+   * @param seed Seed.
+   */
+  void setSeed(const unsigned seed);
+
   /**
    * Perform one iteration step of optimiser.
    */
@@ -184,6 +211,12 @@ public:
    */
   bool hasConverged(const real stopSize = 1.0e-4);
 
+  /**
+   * Get current value of the objective, as log-likelihood or log-posterior
+   * according to mode.
+   */
+  double getValue() const;
+
   /**
    * Output current state.
    *
@@ -226,11 +259,53 @@ private:
    */
   OptimiserMode mode;
 
+  /**
+   * Use common random numbers?
+   */
+  bool crn;
+
+  /**
+   * Random number generator for evaluations with common random numbers.
+   */
+  Random crnRng;
+
+  /**
+   * Seed for common random numbers, negative if not yet set.
+   */
+  long seed;
+
+  /**
+   * Cache of evaluations.
+   */
+  EvaluationCache* cache;
+
   /**
    * Current state.
    */
   NelderMeadOptimiserState state;
 
+  /**
+   * Initialise filter at parameters to evaluate.
+   *
+   * @param x Parameters.
+   * @param params Parameter structure passed to cost function.
+   */
+  template <class S, class IO1, class IO2>
+  static void prepare(const gsl_vector* x,
+      NelderMeadOptimiserParams<B,F,S,IO1,IO2>* params);
+
+  /**
+   * Evaluate log-likelihood, through the cache if there is one.
+   *
+   * @param x Parameters.
+   * @param params Parameter structure passed to cost function.
+   *
+   * @return Log-likelihood, NaN if the filter failed.
+   */
+  template <class S, class IO1, class IO2>
+  static double logLikelihood(const gsl_vector* x,
+      NelderMeadOptimiserParams<B,F,S,IO1,IO2>* params);
+
   /**
    * Cost function for maximum likelihood.
    */
@@ -264,8 +339,9 @@ struct NelderMeadOptimiserFactory {
    */
   template<class B, class F>
   static NelderMeadOptimiser<B,F>* create(B& m, F& filter,
-      const OptimiserMode mode = MAXIMUM_LIKELIHOOD) {
-    return new NelderMeadOptimiser<B,F>(m, filter, mode);
+      const OptimiserMode mode = MAXIMUM_LIKELIHOOD, const bool crn = false,
+      EvaluationCache* cache = NULL) {
+    return new NelderMeadOptimiser<B,F>(m, filter, mode, crn, cache);
   }
 };
 }
@@ -274,13 +350,17 @@ struct NelderMeadOptimiserFactory {
 #include "../math/view.hpp"
 #include "../math/temp_vector.hpp"
 #include "../misc/exception.hpp"
+#include "../misc/omp.hpp"
 
 #include "../misc/TicToc.hpp"
 
+#include <limits>
+
 template<class B, class F>
 bi::NelderMeadOptimiser<B,F>::NelderMeadOptimiser(B& m, F& filter,
-    const OptimiserMode mode) :
-    m(m), filter(filter), mode(mode), state(B::NP) {
+    const OptimiserMode mode, const bool crn, EvaluationCache* cache) :
+    m(m), filter(filter), mode(mode), crn(crn), seed(-1), cache(cache),
+    state(B::NP) {
   //
 }
 
@@ -322,13 +402,19 @@ void bi::NelderMeadOptimiser<B,F>::init(Random& rng,
   /* parameters */
   NelderMeadOptimiserParams<B,F,S,IO1,IO2>* params = new NelderMeadOptimiserParams<B,F,S,IO1,IO2>();  ///@todo Leaks
   params->m = &m;
-  params->rng = &rng;
+  params->rng = crn ? &crnRng : &rng;
   params->s = &s;
   params->filter = &filter;
   params->out = &out;
   params->in = &inInit;
   params->first = first;
   params->last = last;
+  params->cache = cache;
+  params->crn = crn;
+  if (seed < 0) {
+    seed = rng.uniformInt(0, std::numeric_limits<int>::max());
+  }
+  params->seed = seed;
 
   /* function */
   gsl_multimin_function* f = new gsl_multimin_function();  ///@todo Leaks
@@ -343,6 +429,11 @@ void bi::NelderMeadOptimiser<B,F>::init(Random& rng,
   gsl_multimin_fminimizer_set(state.minimizer, f, state.x, state.step);
 }
 
+template<class B, class F>
+inline void bi::NelderMeadOptimiser<B,F>::setSeed(const unsigned seed) {
+  this->seed = seed;
+}
+
 template<class B, class F>
 void bi::NelderMeadOptimiser<B,F>::step() {
   int status = gsl_multimin_fminimizer_iterate(state.minimizer);
@@ -355,6 +446,11 @@ bool bi::NelderMeadOptimiser<B,F>::hasConverged(const real stopSize) {
   return gsl_multimin_test_size(state.size, stopSize) == GSL_SUCCESS;
 }
 
+template<class B, class F>
+inline double bi::NelderMeadOptimiser<B,F>::getValue() const {
+  return -state.minimizer->fval;
+}
+
 template<class B, class F>
 template<class S, class IO1>
 void bi::NelderMeadOptimiser<B,F>::output(const int k,
@@ -378,6 +474,58 @@ void bi::NelderMeadOptimiser<B,F>::term() {
   //
 }
 
+template<class B, class F>
+template<class S, class IO1, class IO2>
+void bi::NelderMeadOptimiser<B,F>::prepare(const gsl_vector* x,
+    NelderMeadOptimiserParams<B,F,S,IO1,IO2>* p) {
+  if (p->crn) {
+    /* seeds() offsets the seed of each thread by its number; the calling
+     * thread, which is the only one used when evaluations are themselves
+     * run in parallel, is reseeded as thread zero would be */
+    p->rng->seeds(p->seed);
+    p->rng->seed(p->seed * bi_omp_max_threads);
+  }
+  p->filter->init(*p->rng, *(p->first), *p->s, *p->out, *p->in);
+
+  /* parameters */
+  vec(p->s->get(P_VAR)) = gsl_vector_reference(x);
+  p->s->get(PY_VAR) = p->s->get(P_VAR);
+  p->m->parameterSimulate(*p->s);
+
+  /* prior log-density */
+  p->s->get(PY_VAR) = p->s->get(P_VAR);
+  p->s->logPrior = p->m->parameterLogDensity(*p->s);
+
+  /* state variable initial values, which may depend on parameters, with
+   * those given in the initialisation file kept */
+  p->filter->initStates(*p->rng, *(p->first), *p->s, *p->in);
+}
+
+template<class B, class F>
+template<class S, class IO1, class IO2>
+double bi::NelderMeadOptimiser<B,F>::logLikelihood(const gsl_vector* x,
+    NelderMeadOptimiserParams<B,F,S,IO1,IO2>* p) {
+  const unsigned seed = p->crn ? p->seed : 0;
+  double ll;
+
+  if (p->cache == NULL
+      || !p->cache->get(gsl_vector_reference(x), seed, ll)) {
+    try {
+      prepare(x, p);
+      p->filter->filter(*p->rng, p->first, p->last, *p->s, *p->out);
+      ll = p->s->logLikelihood;
+    } catch (CholeskyException e) {
+      ll = GSL_NAN;
+    } catch (ParticleFilterDegeneratedException e) {
+      ll = GSL_NAN;
+    }
+    if (p->cache != NULL) {
+      p->cache->put(gsl_vector_reference(x), seed, ll);
+    }
+  }
+  return ll;
+}
+
 template<class B, class F>
 template<class S, class IO1, class IO2>
 double bi::NelderMeadOptimiser<B,F>::ml(const gsl_vector* x,
@@ -386,16 +534,7 @@ double bi::NelderMeadOptimiser<B,F>::ml(const gsl_vector* x,
   param_type* p = reinterpret_cast<param_type*>(params);
 
   /* evaluate */
-  try {
-    p->filter->init(*p->rng, *(p->first), *p->s, *p->out, *p->in);
-    p->filter->filter(*p->rng, p->first, p->last, *p->s, *p->out);
-    real ll = (*p->s).logLikelihood;
-    return -ll;
-  } catch (CholeskyException e) {
-    return GSL_NAN;
-  } catch (ParticleFilterDegeneratedException e) {
-    return GSL_NAN;
-  }
+  return -logLikelihood(x, p);
 }
 
 template<class B, class F>
@@ -415,14 +554,7 @@ double bi::NelderMeadOptimiser<B,F>::map(const gsl_vector* x,
 
   /* evaluate */
   if (bi::is_finite(lp)) {
-    try {
-      p->filter->init(*p->rng, *(p->first), *p->s, *p->out, *p->in);
-      p->filter->filter(*p->rng, p->first, p->last, *p->s, *p->out);
-      real ll = (*p->s).logLikelihood;
-      return -(ll + lp);
-    } catch (CholeskyException e) {
-      return GSL_NAN;
-    }
+    return -(logLikelihood(x, p) + lp);
   } else {
     return GSL_NAN;
   }
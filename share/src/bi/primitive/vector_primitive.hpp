@@ -187,13 +187,16 @@ typename V1::value_type sumexpsq_reduce(const V1 x);
  *
  * @param lws \f$\log \mathbf{w}\f$; log-weights.
  * @param[out] lW If given, contains the mean of the weights on exit.
+ * @param[out] lMax If given, contains the maximum of the log-weights on
+ * exit.
  *
  * @return Effective sample size computed from given weights.
  *
  * \f[ESS = \frac{\left(\sum_i w_i\right)^2}{\sum_i w_i^2}\f]
  */
 template<class V1>
-typename V1::value_type ess_reduce(const V1 lws, double* lW = NULL);
+typename V1::value_type ess_reduce(const V1 lws, double* lW = NULL,
+    double* lMax = NULL);
 
 /**
  * Compute conditional acceptance rate as in
@@ -959,7 +962,8 @@ inline typename V1::value_type bi::sumexpsq_reduce(const V1 x) {
 }
 
 template<class V1>
-typename V1::value_type bi::ess_reduce(const V1 lws, double* lW) {
+typename V1::value_type bi::ess_reduce(const V1 lws, double* lW,
+    double* lMax) {
   /* pre-condition */
   BI_ASSERT(lws.size() > 0);
 
@@ -972,6 +976,9 @@ typename V1::value_type bi::ess_reduce(const V1 lws, double* lW) {
   if (lW != NULL) {
     *lW = mx + bi::log(sum.first) - bi::log(double(lws.size()));
   }
+  if (lMax != NULL) {
+    *lMax = mx;
+  }
   return sum.first * sum.first / sum.second;
 }
 
@@ -13,6 +13,8 @@
 #include "../misc/location.hpp"
 #include "../cuda/cuda.hpp"
 
+#include "boost/serialization/split_member.hpp"
+
 #ifdef ENABLE_CUDA
 #include "../cuda/random/curandStateSA.hpp"
 #endif
@@ -42,6 +44,11 @@ namespace bi {
  * variable before it is copied back to global memory with #setDevRng.
  *
  * Internally, the plural methods take this approach.
+ *
+ * This class supports serialization through the Boost.Serialization
+ * library, so that a run may be checkpointed and resumed. Only the host
+ * PRNGs are serialized, and these may only be restored with the same number
+ * of threads as they were saved with. Device PRNGs are not serialized.
  */
 class Random {
 public:
@@ -278,6 +285,25 @@ public:
    * launch, the random number generators are not destroyed on exit.
    */
   bool own;
+
+private:
+  /**
+   * Serialize.
+   */
+  template<class Archive>
+  void save(Archive& ar, const unsigned version) const;
+
+  /**
+   * Restore from serialization.
+   */
+  template<class Archive>
+  void load(Archive& ar, const unsigned version);
+
+  /*
+   * Boost.Serialization requirements.
+   */
+  BOOST_SERIALIZATION_SPLIT_MEMBER()
+  friend class boost::serialization::access;
 };
 }
 
@@ -286,6 +312,11 @@ public:
 #include "../cuda/random/RandomGPU.hpp"
 #endif
 
+#include "boost/serialization/string.hpp"
+
+#include <sstream>
+#include <string>
+
 inline void bi::Random::seed(const unsigned seed) {
   getHostRng().seed(seed);
 }
@@ -379,4 +410,31 @@ inline bi::RngHost& bi::Random::getHostRng() {
 //}
 #endif
 
+template<class Archive>
+void bi::Random::save(Archive& ar, const unsigned version) const {
+  int nthreads = bi_omp_max_threads;
+  ar & nthreads;
+  for (int i = 0; i < nthreads; ++i) {
+    std::stringstream buf;
+    buf << hostRngs[i].rng;
+    std::string str = buf.str();
+    ar & str;
+  }
+}
+
+template<class Archive>
+void bi::Random::load(Archive& ar, const unsigned version) {
+  int nthreads;
+  ar & nthreads;
+  BI_ERROR_MSG(nthreads == bi_omp_max_threads,
+      "Random number generators saved with " << nthreads <<
+      " threads cannot be restored with " << bi_omp_max_threads);
+  for (int i = 0; i < nthreads; ++i) {
+    std::string str;
+    ar & str;
+    std::stringstream buf(str);
+    buf >> hostRngs[i].rng;
+  }
+}
+
 #endif
@@ -103,6 +103,11 @@
  * filtering within adaptive Metropolis-Hastings sampling, <b>2010</b>.
  * http://arxiv.org/abs/1006.1914
  *
+ * @anchor Pitt2012
+ * Pitt, M. K.; Silva, R. S.; Giordani, P. & Kohn, R. On some properties of
+ * Markov chain Monte Carlo simulation methods based on the particle filter.
+ * <i>Journal of Econometrics</i>, <b>2012</b>, 171, 134-151.
+ *
  * @anchor Sarkka2008
  * Särkkä, S. Unscented Rauch-Tung-Striebel Smoother. <i>IEEE Transactions on
  * Automated Control</i>, <b>2008</b>, 53, 845-849.
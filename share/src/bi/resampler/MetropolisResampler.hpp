@@ -8,11 +8,24 @@
 #ifndef BI_RESAMPLER_METROPOLISRESAMPLER_HPP
 #define BI_RESAMPLER_METROPOLISRESAMPLER_HPP
 
+#include "misc.hpp"
 #include "../cuda/cuda.hpp"
 #include "../random/Random.hpp"
 #include "../misc/exception.hpp"
 
 namespace bi {
+/**
+ * Precomputed object for MetropolisResampler.
+ *
+ * @ingroup method_resampler
+ */
+struct MetropolisResamplerPrecompute {
+  /**
+   * Number of steps to take.
+   */
+  int B;
+};
+
 /**
  * Metropolis resampler for particle filter.
  *
@@ -20,20 +33,35 @@ namespace bi {
  *
  * Implements the Metropolis resampler as described in @ref Murray2011a
  * "Murray (2011)" and @ref Murray2014 "Murray, Lee & Jacob (2014)".
+ *
+ * The number of steps may be fixed, or adapted to the weights at each
+ * resampling step. In the latter case, given a bound \f$\epsilon\f$ on the
+ * bias and the ratio \f$\beta\f$ of the mean to the maximum weight, the
+ * number of steps is chosen as the smallest \f$B\f$ with
+ * \f$(1 - \beta)^B \leq \epsilon\f$, after @ref Murray2014
+ * "Murray, Lee & Jacob (2014)". The mean and maximum weight are computed by
+ * #precompute, over the same weights from which ancestors are then drawn,
+ * and the number of steps is passed to the draw in the precomputed object,
+ * rather than stored in the resampler, so that a resampler may be shared
+ * between threads. With DistributedResampler, precomputation is on the root
+ * process, over the weights of all processes, so adds no collective
+ * operations. The numbers of steps chosen are recorded, for diagnostics.
  */
 class MetropolisResampler {
 public:
   /**
    * Constructor.
    *
-   * @param B Number of Metropolis steps to take.
-   * @param essRel Minimum ESS, as proportion of total number of particles,
-   * to trigger resampling.
+   * @param B Number of Metropolis steps to take. If @p bias is positive,
+   * the maximum number of steps, zero for no maximum.
+   * @param bias Bound on bias for adaptive choice of number of steps, zero
+   * for a fixed number of steps.
    */
-  MetropolisResampler(const int B = 0);
+  MetropolisResampler(const int B = 0, const double bias = 0.0);
 
   /**
-   * Get number of steps.
+   * Get number of steps. If adaptive, the maximum number of steps, zero for
+   * no maximum.
    */
   int getSteps() const;
 
@@ -42,32 +70,97 @@ public:
    */
   void setSteps(const int B);
 
+  /**
+   * Get bound on bias.
+   */
+  double getBias() const;
+
+  /**
+   * Set bound on bias, zero for a fixed number of steps.
+   */
+  void setBias(const double bias);
+
+  /**
+   * Choose number of steps for weights.
+   *
+   * @param lW Logarithm of mean weight.
+   * @param lMax Logarithm of maximum weight.
+   *
+   * @return Number of steps; if not adaptive, the fixed number of steps.
+   */
+  int chooseSteps(const double lW, const double lMax) const;
+
+  /**
+   * Get mean number of steps chosen by adaptation.
+   */
+  double getMeanSteps() const;
+
+  /**
+   * Get maximum number of steps chosen by adaptation.
+   */
+  int getMaxSteps() const;
+
   /**
    * @copydoc MultinomialResampler::ancestors
    */
-  template<class V1, class V2, Location L>
+  template<class V1, class V2>
   void ancestors(Random& rng, const V1 lws, V2 as,
-      ResamplerPrecompute<L>& pre) throw (ParticleFilterDegeneratedException);
+      MetropolisResamplerPrecompute& pre)
+          throw (ParticleFilterDegeneratedException);
 
   /**
    * @copydoc MultinomialResampler::ancestorsPermute
    */
-  template<class V1, class V2, Location L>
+  template<class V1, class V2>
   void ancestorsPermute(Random& rng, const V1 lws, V2 as,
-      ResamplerPrecompute<L>& pre) throw (ParticleFilterDegeneratedException);
+      MetropolisResamplerPrecompute& pre)
+          throw (ParticleFilterDegeneratedException);
 
   /**
    * @copydoc MultinomialResampler::offspring
    */
-  template<class V1, class V2, Location L>
+  template<class V1, class V2>
   void offspring(Random& rng, const V1 lws, const int P, V2 os,
-      ResamplerPrecompute<L>& pre) throw (ParticleFilterDegeneratedException);
+      MetropolisResamplerPrecompute& pre)
+          throw (ParticleFilterDegeneratedException);
+
+  /**
+   * Choose the number of steps for the given weights.
+   *
+   * @tparam V1 Vector type.
+   *
+   * @param lws Log-weights.
+   * @param[out] pre Precomputed object.
+   */
+  template<class V1>
+  void precompute(const V1 lws, MetropolisResamplerPrecompute& pre);
 
 private:
   /**
-   * Number of Metropolis steps to take.
+   * Number of Metropolis steps to take. If adaptive, the maximum number of
+   * steps, zero for no maximum.
    */
   int B;
+
+  /**
+   * Bound on bias, if adaptive.
+   */
+  double bias;
+
+  /**
+   * Number of adaptations.
+   */
+  int nadapts;
+
+  /**
+   * Total number of steps chosen by adaptation.
+   */
+  long totalSteps;
+
+  /**
+   * Maximum number of steps chosen by adaptation.
+   */
+  int maxSteps;
 };
 
 /**
@@ -75,7 +168,7 @@ private:
  */
 template<Location L>
 struct precompute_type<MetropolisResampler,L> {
-  typedef ResamplerPrecompute<L> type;
+  typedef MetropolisResamplerPrecompute type;
 };
 }
 
@@ -84,10 +177,14 @@ struct precompute_type<MetropolisResampler,L> {
 #include "../cuda/resampler/MetropolisResamplerGPU.cuh"
 #endif
 #include "../math/sim_temp_vector.hpp"
+#include "../math/function.hpp"
+#include "../primitive/vector_primitive.hpp"
 
-inline bi::MetropolisResampler::MetropolisResampler(const int B) :
-    B(B) {
-  //
+inline bi::MetropolisResampler::MetropolisResampler(const int B,
+    const double bias) :
+    B(B), bias(bias), nadapts(0), totalSteps(0), maxSteps(0) {
+  /* pre-condition */
+  BI_ASSERT(bias >= 0.0 && bias < 1.0);
 }
 
 inline int bi::MetropolisResampler::getSteps() const {
@@ -98,21 +195,79 @@ inline void bi::MetropolisResampler::setSteps(const int B) {
   this->B = B;
 }
 
-template<class V1, class V2, bi::Location L>
+inline double bi::MetropolisResampler::getBias() const {
+  return bias;
+}
+
+inline void bi::MetropolisResampler::setBias(const double bias) {
+  /* pre-condition */
+  BI_ASSERT(bias >= 0.0 && bias < 1.0);
+
+  this->bias = bias;
+}
+
+inline int bi::MetropolisResampler::chooseSteps(const double lW,
+    const double lMax) const {
+  int B1 = B;
+  if (bias > 0.0 && bi::is_finite(lW) && bi::is_finite(lMax)) {
+    /* ratio of mean to maximum weight */
+    double beta = bi::exp(lW - lMax);
+    if (beta < 1.0) {
+      B1 = static_cast<int>(bi::ceil(bi::log(bias) / bi::log(1.0 - beta)));
+      B1 = bi::max(B1, 1);
+    } else {
+      B1 = 1;
+    }
+    if (B > 0) {
+      B1 = bi::min(B1, B);
+    }
+  }
+  return B1;
+}
+
+inline double bi::MetropolisResampler::getMeanSteps() const {
+  return (nadapts > 0) ? double(totalSteps) / nadapts : double(B);
+}
+
+inline int bi::MetropolisResampler::getMaxSteps() const {
+  return (nadapts > 0) ? maxSteps : B;
+}
+
+template<class V1>
+void bi::MetropolisResampler::precompute(const V1 lws,
+    MetropolisResamplerPrecompute& pre) {
+  if (bias > 0.0) {
+    double lW, lMax;
+    ess_reduce(lws, &lW, &lMax);
+    pre.B = chooseSteps(lW, lMax);
+
+    #pragma omp critical(MetropolisResampler)
+    {
+      ++nadapts;
+      totalSteps += pre.B;
+      maxSteps = bi::max(maxSteps, pre.B);
+    }
+  } else {
+    pre.B = B;
+  }
+}
+
+template<class V1, class V2>
 void bi::MetropolisResampler::ancestors(Random& rng, const V1 lws, V2 as,
-    ResamplerPrecompute<L>& pre) throw (ParticleFilterDegeneratedException) {
+    MetropolisResamplerPrecompute& pre)
+        throw (ParticleFilterDegeneratedException) {
 #ifdef __CUDACC__
   typedef typename boost::mpl::if_c<V1::on_device,MetropolisResamplerGPU,
   MetropolisResamplerHost>::type impl;
 #else
   typedef MetropolisResamplerHost impl;
 #endif
-  impl::ancestors(rng, lws, as, B);
+  impl::ancestors(rng, lws, as, pre.B);
 }
 
-template<class V1, class V2, bi::Location L>
+template<class V1, class V2>
 void bi::MetropolisResampler::ancestorsPermute(Random& rng, const V1 lws,
-    V2 as, ResamplerPrecompute<L>& pre)
+    V2 as, MetropolisResamplerPrecompute& pre)
         throw (ParticleFilterDegeneratedException) {
 #ifdef __CUDACC__
   typedef typename boost::mpl::if_c<V1::on_device,MetropolisResamplerGPU,
@@ -120,14 +275,15 @@ void bi::MetropolisResampler::ancestorsPermute(Random& rng, const V1 lws,
 #else
   typedef MetropolisResamplerHost impl;
 #endif
-  impl::ancestorsPermute(rng, lws, as, B);
+  impl::ancestorsPermute(rng, lws, as, pre.B);
 }
 
-template<class V1, class V2, bi::Location L>
-void bi::MetropolisResampler::offspring(Random& rng, const V1 lws, const int P, V2 os,
-    ResamplerPrecompute<L>& pre) throw (ParticleFilterDegeneratedException) {
+template<class V1, class V2>
+void bi::MetropolisResampler::offspring(Random& rng, const V1 lws,
+    const int P, V2 os, MetropolisResamplerPrecompute& pre)
+        throw (ParticleFilterDegeneratedException) {
   typename sim_temp_vector<V1>::type as(P);
-  ancestors(rng, lws, as);
+  ancestors(rng, lws, as, pre);
   ancestorsToOffspring(as, os);
 }
 
@@ -157,10 +157,14 @@ void bi::Resampler<R>::setMaxLogWeight(const double maxLogWeight) {
 template<class R>
 template<class V1>
 double bi::Resampler<R>::reduce(const V1 lws, double* lW) {
-  double ess = ess_reduce(lws, lW);
+  double lW1;
+  double ess = ess_reduce(lws, &lW1);
   if (anytime) {
     const int P = lws.size();
-    *lW += bi::log(P / (P - 1.0));
+    lW1 += bi::log(P / (P - 1.0));
+  }
+  if (lW != NULL) {
+    *lW = lW1;
   }
   return ess;
 }
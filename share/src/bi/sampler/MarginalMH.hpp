@@ -10,6 +10,9 @@
 
 #include "../state/Schedule.hpp"
 #include "../misc/exception.hpp"
+#include "../misc/Checkpointer.hpp"
+
+#include "boost/serialization/split_member.hpp"
 
 namespace bi {
 /**
@@ -19,14 +22,28 @@ namespace bi {
  *
  * @tparam B Model type
  * @tparam F Filter type.
+ * @tparam A Adapter type.
  *
  * Implements a marginal Metropolis--Hastings sampler, which, when combined
  * with a particle filter, gives the particle marginal Metropolis--Hastings
  * sampler described in @ref Andrieu2010 "Andrieu, Doucet \& Holenstein (2010)".
  *
- * @todo Add proposal adaptation using adapter classes.
+ * When adaptation is enabled, each state of the chain is added to the
+ * adapter, and once the adapter is ready its proposal is used in place of
+ * that of the model.
+ *
+ * When a Checkpointer is given, the chain, the random number generators and
+ * the adapter are checkpointed periodically, after output to that point has
+ * been written to disk. If a checkpoint exists when #sample is called, the
+ * chain resumes from it, continuing exactly as it would have had it not
+ * been interrupted, and appending to the existing output file.
+ *
+ * The log-likelihood may be tempered by an inverse temperature
+ * \f$\beta\f$, so that the chain targets a distribution proportional to
+ * the prior times the likelihood to the power \f$\beta\f$, as for the
+ * chains of MarginalPT.
  */
-template<class B, class F>
+template<class B, class F, class A>
 class MarginalMH {
 public:
   /**
@@ -34,8 +51,13 @@ public:
    *
    * @param m Model.
    * @param filter Filter.
+   * @param adapter Adapter.
+   * @param adaptive Use adapter?
+   * @param checkpointer Checkpointer, NULL for none.
+   * @param beta Inverse temperature.
    */
-  MarginalMH(B& m, F& filter);
+  MarginalMH(B& m, F& filter, A& adapter, const bool adaptive = false,
+      Checkpointer* checkpointer = NULL, const double beta = 1.0);
 
   /**
    * @name High-level interface
@@ -121,6 +143,18 @@ public:
   template<class S1, class S2, class IO1>
   bool acceptReject(Random& rng, S1& s1, S2& s2, IO1& out);
 
+  /**
+   * Adapt proposal.
+   *
+   * @tparam S1 State type.
+   *
+   * @param s1 Current state.
+   *
+   * Adds the current state to the adapter, if adaptation is enabled.
+   */
+  template<class S1>
+  void adapt(const S1& s1);
+
   /**
    * Output.
    *
@@ -153,10 +187,36 @@ public:
   template<class S1, class S2>
   void report(const int c, const S1& s1, const S2& s2);
 
+  /**
+   * Checkpoint, if due.
+   *
+   * @tparam S1 State type.
+   * @tparam IO1 Output type.
+   *
+   * @param rng Random number generator.
+   * @param s State.
+   * @param[in,out] out Output buffer.
+   *
+   * Output is flushed and synchronised to disk before the checkpoint is
+   * written.
+   */
+  template<class S1, class IO1>
+  void checkpoint(Random& rng, const S1& s, IO1& out);
+
   /**
    * Terminate.
    */
   void term();
+
+  /**
+   * Get the inverse temperature.
+   */
+  double getBeta() const;
+
+  /**
+   * Get the acceptance rate so far.
+   */
+  double getAcceptRate() const;
   //@}
 
 private:
@@ -170,6 +230,21 @@ private:
    */
   F& filter;
 
+  /**
+   * Adapter.
+   */
+  A& adapter;
+
+  /**
+   * Use adapter?
+   */
+  bool adaptive;
+
+  /**
+   * Inverse temperature.
+   */
+  double beta;
+
   /**
    * Was the last proposal accepted?
    */
@@ -184,41 +259,79 @@ private:
    * Total number of proposals.
    */
   int total;
+
+  /**
+   * Index of current sample.
+   */
+  int c;
+
+  /**
+   * Checkpointer.
+   */
+  Checkpointer* checkpointer;
+
+  /**
+   * Serialize.
+   */
+  template<class Archive>
+  void save(Archive& ar, const unsigned version) const;
+
+  /**
+   * Restore from serialization.
+   */
+  template<class Archive>
+  void load(Archive& ar, const unsigned version);
+
+  /*
+   * Boost.Serialization requirements.
+   */
+  BOOST_SERIALIZATION_SPLIT_MEMBER()
+  friend class boost::serialization::access;
 };
 }
 
 #include "../misc/TicToc.hpp"
 
-template<class B, class F>
-bi::MarginalMH<B,F>::MarginalMH(B& m, F& filter) :
-    m(m), filter(filter), lastAccepted(false), accepted(0), total(0) {
+template<class B, class F, class A>
+bi::MarginalMH<B,F,A>::MarginalMH(B& m, F& filter, A& adapter,
+    const bool adaptive, Checkpointer* checkpointer, const double beta) :
+    m(m), filter(filter), adapter(adapter), adaptive(adaptive), beta(beta), lastAccepted(
+        false), accepted(0), total(0), c(0), checkpointer(checkpointer) {
   //
 }
 
-template<class B, class F>
+template<class B, class F, class A>
 template<class S1, class IO1, class IO2>
-void bi::MarginalMH<B,F>::sample(Random& rng, const ScheduleIterator first,
+void bi::MarginalMH<B,F,A>::sample(Random& rng, const ScheduleIterator first,
     const ScheduleIterator last, S1& s, const int C, IO1& out, IO2& inInit) {
   /* pre-condition */
   BI_ERROR(C > 0);
 
   TicToc clock;
-  init(rng, first, last, s.s1, s.out, inInit);
-  output(0, s.s1, out);
-  for (int c = 1; c < C; ++c) {
+  if (checkpointer != NULL && checkpointer->canResume()) {
+    checkpointer->read(*this, rng, s);
+  } else {
+    init(rng, first, last, s.s1, s.out, inInit);
+    output(0, s.s1, out);
+    adapt(s.s1);
+    c = 0;
+  }
+  for (++c; c < C; ++c) {
     propose(rng, first, last, s.s1, s.s2, s.out);
     acceptReject(rng, s.s1, s.s2, s.out);
+    adapt(s.s1);
     report(c, s.s1, s.s2);
     output(c, s.s1, out);
+    checkpoint(rng, s, out);
   }
   s.clock = clock.toc();
   outputT(s, out);
   term();
 }
 
-template<class B, class F>
+template<class B, class F, class A>
 template<class S1, class IO1, class IO2>
-void bi::MarginalMH<B,F>::init(Random& rng, const ScheduleIterator first,
+void bi::MarginalMH<B,F,A>::init(Random& rng, const ScheduleIterator first,
     const ScheduleIterator last, S1& s1, IO1& out, IO2& inInit) {
   filter.init(rng, *first, s1, out, inInit);
   filter.filter(rng, first, last, s1, out);
@@ -226,14 +339,21 @@ void bi::MarginalMH<B,F>::init(Random& rng, const ScheduleIterator first,
   lastAccepted = true;
   accepted = 1;
   total = 1;
+  if (adaptive) {
+    adapter.reset();
+  }
 }
 
-template<class B, class F>
+template<class B, class F, class A>
 template<class S1, class S2, class IO1>
-void bi::MarginalMH<B,F>::propose(Random& rng, const ScheduleIterator first,
+void bi::MarginalMH<B,F,A>::propose(Random& rng, const ScheduleIterator first,
     const ScheduleIterator last, S1& s1, S2& s2, IO1& out) {
   try {
-    filter.propose(rng, *first, s1, s2, out);
+    if (adaptive && adapter.ready()) {
+      filter.propose(rng, *first, s1, s2, out, adapter);
+    } else {
+      filter.propose(rng, *first, s1, s2, out);
+    }
     if (bi::is_finite(s2.logPrior)) {
       filter.filter(rng, first, last, s2, out);
     } else {
@@ -246,15 +366,15 @@ void bi::MarginalMH<B,F>::propose(Random& rng, const ScheduleIterator first,
   }
 }
 
-template<class B, class F>
+template<class B, class F, class A>
 template<class S1, class S2, class IO1>
-bool bi::MarginalMH<B,F>::acceptReject(Random& rng, S1& s1, S2& s2, IO1& out) {
+bool bi::MarginalMH<B,F,A>::acceptReject(Random& rng, S1& s1, S2& s2, IO1& out) {
   if (!bi::is_finite(s2.logLikelihood)) {
     lastAccepted = false;
   } else if (!bi::is_finite(s1.logLikelihood)) {
     lastAccepted = true;
   } else {
-    double loglr = s2.logLikelihood - s1.logLikelihood;
+    double loglr = beta * (s2.logLikelihood - s1.logLikelihood);
     double logpr = s2.logPrior - s1.logPrior;
     double logqr = s1.logProposal - s2.logProposal;
     double logratio = loglr + logpr + logqr;
@@ -273,9 +393,17 @@ bool bi::MarginalMH<B,F>::acceptReject(Random& rng, S1& s1, S2& s2, IO1& out) {
   return lastAccepted;
 }
 
-template<class B, class F>
+template<class B, class F, class A>
+template<class S1>
+void bi::MarginalMH<B,F,A>::adapt(const S1& s1) {
+  if (adaptive) {
+    adapter.add(s1);
+  }
+}
+
+template<class B, class F, class A>
 template<class S1, class IO1>
-void bi::MarginalMH<B,F>::output(const int c, const S1& s1, IO1& out) {
+void bi::MarginalMH<B,F,A>::output(const int c, const S1& s1, IO1& out) {
   out.write(c, s1);
   if (out.isFull()) {
     out.flush();
@@ -283,15 +411,15 @@ void bi::MarginalMH<B,F>::output(const int c, const S1& s1, IO1& out) {
   }
 }
 
-template<class B, class F>
+template<class B, class F, class A>
 template<class S1, class IO1>
-void bi::MarginalMH<B,F>::outputT(const S1& s, IO1& out) {
+void bi::MarginalMH<B,F,A>::outputT(const S1& s, IO1& out) {
   out.writeClock(s.clock);
 }
 
-template<class B, class F>
+template<class B, class F, class A>
 template<class S1, class S2>
-void bi::MarginalMH<B,F>::report(const int c, const S1& s1, const S2& s2) {
+void bi::MarginalMH<B,F,A>::report(const int c, const S1& s1, const S2& s2) {
   std::cerr << c << ":\t";
   std::cerr.width(10);
   std::cerr << s1.logLikelihood;
@@ -318,9 +446,53 @@ void bi::MarginalMH<B,F>::report(const int c, const S1& s1, const S2& s2) {
   std::cerr << std::endl;
 }
 
-template<class B, class F>
-void bi::MarginalMH<B,F>::term() {
-  //
+template<class B, class F, class A>
+template<class S1, class IO1>
+void bi::MarginalMH<B,F,A>::checkpoint(Random& rng, const S1& s,
+    IO1& out) {
+  if (checkpointer != NULL && checkpointer->isDue(c)) {
+    out.flush();
+    out.clear();
+    out.sync();
+    checkpointer->write(*this, rng, s);
+  }
+}
+
+template<class B, class F, class A>
+void bi::MarginalMH<B,F,A>::term() {
+  if (checkpointer != NULL) {
+    checkpointer->wait();
+  }
+}
+
+template<class B, class F, class A>
+double bi::MarginalMH<B,F,A>::getBeta() const {
+  return beta;
+}
+
+template<class B, class F, class A>
+double bi::MarginalMH<B,F,A>::getAcceptRate() const {
+  return (total > 0) ? double(accepted) / total : 0.0;
+}
+
+template<class B, class F, class A>
+template<class Archive>
+void bi::MarginalMH<B,F,A>::save(Archive& ar, const unsigned version) const {
+  ar & lastAccepted;
+  ar & accepted;
+  ar & total;
+  ar & c;
+  ar & adapter;
+}
+
+template<class B, class F, class A>
+template<class Archive>
+void bi::MarginalMH<B,F,A>::load(Archive& ar, const unsigned version) {
+  ar & lastAccepted;
+  ar & accepted;
+  ar & total;
+  ar & c;
+  ar & adapter;
 }
 
 #endif
@@ -0,0 +1,264 @@
+/**
+ * @file
+ *
+ * @author Lawrence Murray <lawrence.murray@csiro.au>
+ * $Rev$
+ * $Date$
+ */
+#ifndef BI_SAMPLER_MARGINALPT_HPP
+#define BI_SAMPLER_MARGINALPT_HPP
+
+#include "MarginalMH.hpp"
+
+#include "boost/shared_ptr.hpp"
+
+#include <vector>
+
+namespace bi {
+/**
+ * Marginal Metropolis-Hastings with parallel tempering.
+ *
+ * @ingroup method_sampler
+ *
+ * @tparam B Model type
+ * @tparam F Filter type.
+ * @tparam A Adapter type.
+ *
+ * Runs several MarginalMH chains, with the log-likelihood of chain \f$k\f$
+ * tempered by an inverse temperature \f$\beta_k\f$, in lock step and in
+ * parallel, one per thread. The inverse temperatures are spaced
+ * geometrically from \f$\beta_0 = 1\f$ down to the reciprocal of a maximum
+ * temperature. Periodically, neighbouring chains propose to swap their
+ * states, alternating between even and odd pairs. A swap exchanges only
+ * the parameters, likelihoods and sampled paths of the two chains, which,
+ * as these are held by buffers of the filter state, is done by swapping
+ * pointers. Only the chain with \f$\beta_0 = 1\f$, which targets the
+ * posterior, is output, and only it uses the adapter, if any.
+ *
+ * Each chain has its own filter state and output, and draws from the random
+ * number stream of the thread that runs it. The filter is shared between
+ * threads, as for MultiStartOptimiser: the first chain is initialised
+ * serially, after which the input and observation caches of the filter are
+ * full, and its subsequent use must be safe from multiple threads. This is
+ * the case for all filters but AdaptivePF. The first chain starts from the
+ * initialisation file, if any, the others from draws from the prior.
+ */
+template<class B, class F, class A>
+class MarginalPT {
+public:
+  /**
+   * Constructor.
+   *
+   * @param m Model.
+   * @param filter Filter.
+   * @param adapter Adapter.
+   * @param adaptive Use adapter?
+   * @param ntemps Number of temperatures.
+   * @param maxTemp Maximum temperature.
+   * @param swapInterval Number of steps between swap moves.
+   */
+  MarginalPT(B& m, F& filter, A& adapter, const bool adaptive = false,
+      const int ntemps = 4, const double maxTemp = 10.0,
+      const int swapInterval = 1);
+
+  /**
+   * @name High-level interface
+   *
+   * An easier interface for common usage.
+   */
+  //@{
+  /**
+   * Sample.
+   *
+   * @tparam S1 State type.
+   * @tparam IO1 Output type.
+   * @tparam IO2 Input type.
+   *
+   * @param[in,out] rng Random number generator.
+   * @param first Start of time schedule.
+   * @param last End of time schedule.
+   * @param[in,out] ss States, one per temperature, the first for
+   * \f$\beta_0 = 1\f$.
+   * @param C Number of samples to draw.
+   * @param out Output buffer.
+   * @param inInit Initialisation file.
+   */
+  template<class S1, class IO1, class IO2>
+  void sample(Random& rng, const ScheduleIterator first,
+      const ScheduleIterator last, std::vector<S1*>& ss, const int C,
+      IO1& out, IO2& inInit);
+  //@}
+
+  /**
+   * @name Low-level interface
+   *
+   * Largely used by other features of the library or for finer control over
+   * performance and behaviour.
+   */
+  //@{
+  /**
+   * Propose to swap the states of neighbouring chains.
+   *
+   * @tparam S1 State type.
+   *
+   * @param[in,out] rng Random number generator.
+   * @param odd Swap odd pairs, rather than even?
+   * @param[in,out] ss States.
+   */
+  template<class S1>
+  void swap(Random& rng, const bool odd, std::vector<S1*>& ss);
+
+  /**
+   * Report progress on stderr.
+   *
+   * @tparam S1 State type.
+   *
+   * @param c Number of steps taken.
+   * @param ss States.
+   */
+  template<class S1>
+  void report(const int c, const std::vector<S1*>& ss);
+  //@}
+
+private:
+  /**
+   * Chains, one per temperature.
+   */
+  std::vector<boost::shared_ptr<MarginalMH<B,F,A> > > chains;
+
+  /**
+   * Model.
+   */
+  B& m;
+
+  /**
+   * Number of steps between swap moves.
+   */
+  int swapInterval;
+
+  /**
+   * Number of accepted swaps.
+   */
+  int swapsAccepted;
+
+  /**
+   * Total number of swaps.
+   */
+  int swapsTotal;
+};
+}
+
+#include "../null/InputNullBuffer.hpp"
+#include "../misc/TicToc.hpp"
+
+template<class B, class F, class A>
+bi::MarginalPT<B,F,A>::MarginalPT(B& m, F& filter, A& adapter,
+    const bool adaptive, const int ntemps, const double maxTemp,
+    const int swapInterval) :
+    chains(ntemps), m(m), swapInterval(swapInterval), swapsAccepted(0),
+    swapsTotal(0) {
+  /* pre-condition */
+  BI_ASSERT(ntemps > 0);
+  BI_ASSERT(maxTemp >= 1.0);
+  BI_ASSERT(swapInterval > 0);
+
+  double beta;
+  for (int k = 0; k < ntemps; ++k) {
+    beta = (ntemps > 1) ? bi::pow(maxTemp, -double(k) / (ntemps - 1)) : 1.0;
+    chains[k].reset(new MarginalMH<B,F,A>(m, filter, adapter,
+        adaptive && k == 0, NULL, beta));
+  }
+}
+
+template<class B, class F, class A>
+template<class S1, class IO1, class IO2>
+void bi::MarginalPT<B,F,A>::sample(Random& rng,
+    const ScheduleIterator first, const ScheduleIterator last,
+    std::vector<S1*>& ss, const int C, IO1& out, IO2& inInit) {
+  /* pre-condition */
+  BI_ERROR(C > 0);
+  BI_ASSERT(ss.size() == chains.size());
+
+  const int ntemps = chains.size();
+  InputNullBuffer inNull(m);
+  TicToc clock;
+  int c, k;
+
+  /* the first chain fills the input and observation caches of the filter,
+   * the rest can then be initialised in parallel */
+  chains[0]->init(rng, first, last, ss[0]->s1, ss[0]->out, inInit);
+  #pragma omp parallel for schedule(dynamic)
+  for (k = 1; k < ntemps; ++k) {
+    chains[k]->init(rng, first, last, ss[k]->s1, ss[k]->out, inNull);
+  }
+  chains[0]->output(0, ss[0]->s1, out);
+  chains[0]->adapt(ss[0]->s1);
+
+  for (c = 1; c < C; ++c) {
+    #pragma omp parallel for schedule(dynamic)
+    for (k = 0; k < ntemps; ++k) {
+      chains[k]->propose(rng, first, last, ss[k]->s1, ss[k]->s2, ss[k]->out);
+      chains[k]->acceptReject(rng, ss[k]->s1, ss[k]->s2, ss[k]->out);
+    }
+    if (c % swapInterval == 0) {
+      swap(rng, (c / swapInterval) % 2 == 1, ss);
+    }
+    chains[0]->adapt(ss[0]->s1);
+    report(c, ss);
+    chains[0]->output(c, ss[0]->s1, out);
+  }
+  ss[0]->clock = clock.toc();
+  chains[0]->outputT(*ss[0], out);
+}
+
+template<class B, class F, class A>
+template<class S1>
+void bi::MarginalPT<B,F,A>::swap(Random& rng, const bool odd,
+    std::vector<S1*>& ss) {
+  bool accept;
+  double ll1, ll2, logratio;
+
+  for (int k = odd ? 1 : 0; k + 1 < int(chains.size()); k += 2) {
+    ll1 = ss[k]->s1.logLikelihood;
+    ll2 = ss[k + 1]->s1.logLikelihood;
+    if (!bi::is_finite(ll2)) {
+      accept = false;
+    } else if (!bi::is_finite(ll1)) {
+      accept = true;
+    } else {
+      logratio = (chains[k]->getBeta() - chains[k + 1]->getBeta())
+          * (ll2 - ll1);
+      accept = bi::log(rng.uniform<double>()) < logratio;
+    }
+    if (accept) {
+      ss[k]->s1.swap(ss[k + 1]->s1);
+      ++swapsAccepted;
+    }
+    ++swapsTotal;
+  }
+}
+
+template<class B, class F, class A>
+template<class S1>
+void bi::MarginalPT<B,F,A>::report(const int c,
+    const std::vector<S1*>& ss) {
+  std::cerr << c << ":\t";
+  std::cerr.width(10);
+  std::cerr << ss[0]->s1.logLikelihood;
+  std::cerr << '\t';
+  std::cerr.width(10);
+  std::cerr << ss[0]->s1.logPrior;
+  std::cerr << "\taccept=";
+  for (int k = 0; k < int(chains.size()); ++k) {
+    if (k > 0) {
+      std::cerr << ',';
+    }
+    std::cerr << chains[k]->getAcceptRate();
+  }
+  if (swapsTotal > 0) {
+    std::cerr << "\tswap=" << double(swapsAccepted) / swapsTotal;
+  }
+  std::cerr << std::endl;
+}
+
+#endif
@@ -12,8 +12,11 @@
 #include "../state/Schedule.hpp"
 #include "../misc/exception.hpp"
 #include "../misc/TicToc.hpp"
+#include "../misc/Checkpointer.hpp"
 #include "../primitive/vector_primitive.hpp"
 
+#include "boost/serialization/split_member.hpp"
+
 #include <fstream>
 #include <sstream>
 
@@ -31,6 +34,23 @@ namespace bi {
  * Implements sequential importance resampling over parameters, which, when
  * combined with a particle filter, gives the SMC^2 method described in
  * @ref Chopin2013 "Chopin, Jacob \& Papaspiliopoulos (2013)".
+ *
+ * When a Checkpointer is given, the \f$\theta\f$-particles, the random
+ * number generators and the adapter are checkpointed periodically, after
+ * the \f$x\f$-particles are stepped to an observation and before the
+ * interaction step. If a checkpoint exists when #sample is called, sampling
+ * resumes from it. Resumption is exact, except when a real time budget is
+ * given for move steps, as the number of moves within the budget varies
+ * from run to run anyway.
+ *
+ * When an exchange threshold is given, and the acceptance rate of the move
+ * steps falls below it, the number of \f$x\f$-particles is doubled, as in
+ * the exchange step of @ref Chopin2013 "Chopin, Jacob \& Papaspiliopoulos
+ * (2013)": the filter of each \f$\theta\f$-particle is run afresh with the
+ * new number of \f$x\f$-particles, and its weight multiplied by the ratio of
+ * the new to the old likelihood estimate. This is not supported with a
+ * filter that sets its own number of \f$x\f$-particles, such as AdaptivePF,
+ * for which the exchange threshold should be zero.
  */
 template<class B, class F, class A, class R>
 class MarginalSIR {
@@ -45,9 +65,13 @@ public:
    * @param nmoves Number of move steps per \f$\theta\f$-particle after each
    * resample.
    * @param tmoves Total real time allocated to move steps, in seconds.
+   * @param exchangeRate Acceptance rate below which to double the number
+   * of \f$x\f$-particles, zero to never do so.
+   * @param checkpointer Checkpointer, NULL for none.
    */
   MarginalSIR(B& m, F& filter, A& adapter, R& resam, const int nmoves = 1,
-      const long tmoves = 0.0);
+      const long tmoves = 0.0, const double exchangeRate = 0.0,
+      Checkpointer* checkpointer = NULL);
 
   /**
    * @name High-level interface
@@ -125,6 +149,35 @@ public:
   void move(Random& rng, const ScheduleIterator first,
       const ScheduleIterator iter, const ScheduleIterator last, S1& s);
 
+  /**
+   * Exchange step, doubling the number of \f$x\f$-particles if the
+   * acceptance rate of the last move step is below the exchange threshold.
+   *
+   * @tparam S1 State type.
+   *
+   * @param[in,out] rng Random number generator.
+   * @param first Start of time schedule.
+   * @param iter Current position in time schedule.
+   * @param[in,out] s State.
+   */
+  template<class S1>
+  void exchange(Random& rng, const ScheduleIterator first,
+      const ScheduleIterator iter, S1& s);
+
+  /**
+   * Checkpoint, if due.
+   *
+   * @tparam S1 State type.
+   *
+   * @param rng Random number generator.
+   * @param first Start of time schedule.
+   * @param iter Current position in time schedule.
+   * @param s State.
+   */
+  template<class S1>
+  void checkpoint(Random& rng, const ScheduleIterator first,
+      const ScheduleIterator iter, const S1& s);
+
   /**
    * @copydoc Simulator::outputT()
    */
@@ -170,7 +223,7 @@ private:
    * Step for instrumentation.
    */
   enum Step {
-    INIT, READY, INTERACT, MOVE, STEP, TERM
+    INIT, READY, INTERACT, MOVE, STEP, TERM, EXCHANGE
   };
 
   /**
@@ -220,6 +273,12 @@ private:
    */
   long tmoves;
 
+  /**
+   * Acceptance rate below which to double the number of
+   * \f$x\f$-particles.
+   */
+  double exchangeRate;
+
   /**
    * Start time for current step.
    */
@@ -249,15 +308,45 @@ private:
    * Last total number of moves.
    */
   int lastTotal;
+
+  /**
+   * Position in time schedule, relative to its start, at last checkpoint.
+   */
+  int position;
+
+  /**
+   * Checkpointer.
+   */
+  Checkpointer* checkpointer;
+
+  /**
+   * Serialize.
+   */
+  template<class Archive>
+  void save(Archive& ar, const unsigned version) const;
+
+  /**
+   * Restore from serialization.
+   */
+  template<class Archive>
+  void load(Archive& ar, const unsigned version);
+
+  /*
+   * Boost.Serialization requirements.
+   */
+  BOOST_SERIALIZATION_SPLIT_MEMBER()
+  friend class boost::serialization::access;
 };
 }
 
 template<class B, class F, class A, class R>
 bi::MarginalSIR<B,F,A,R>::MarginalSIR(B& m, F& filter, A& adapter, R& resam,
-    const int nmoves, const long tmoves) :
+    const int nmoves, const long tmoves, const double exchangeRate,
+    Checkpointer* checkpointer) :
     m(m), filter(filter), adapter(adapter), resam(resam), nmoves(nmoves), tmoves(
-        1e6 * tmoves), tstart(0), tmilestone(0), lastResample(false), adapterReady(
-        false), lastAccept(0), lastTotal(0) {
+        1e6 * tmoves), exchangeRate(exchangeRate), tstart(0), tmilestone(0), lastResample(false), adapterReady(
+        false), lastAccept(0), lastTotal(0), position(0), checkpointer(
+        checkpointer) {
 #if ENABLE_DIAGNOSTICS == 4
 #ifdef ENABLE_MPI
   boost::mpi::communicator world;
@@ -287,7 +376,12 @@ void bi::MarginalSIR<B,F,A,R>::sample(Random& rng,
     const int C, IO1& out, IO2& inInit) {
   TicToc clock;
   ScheduleIterator iter = first;
-  init(rng, iter, s, out, inInit);
+  if (checkpointer != NULL && checkpointer->canResume()) {
+    checkpointer->read(*this, rng, s);
+    iter = first + position;
+  } else {
+    init(rng, iter, s, out, inInit);
+  }
   profile(INIT);
   profile(INTERACT);
   interact(rng, *iter, s);
@@ -295,8 +389,11 @@ void bi::MarginalSIR<B,F,A,R>::sample(Random& rng,
   while (iter + 1 != last) {
     profile(MOVE);
     move(rng, first, iter, last, s);
+    profile(EXCHANGE);
+    exchange(rng, first, iter, s);
     profile(STEP);
     step(rng, first, iter, last, s);
+    checkpoint(rng, first, iter, s);
     profile(READY);
     profile(INTERACT);
     interact(rng, *iter, s);
@@ -353,6 +450,7 @@ void bi::MarginalSIR<B,F,A,R>::step(Random& rng, const ScheduleIterator first,
   BI_ASSERT(s.size() > 0);
 
   ScheduleIterator iter1;
+  s.own();
   do {
     for (int p = 0; p < s.size(); ++p) {
       BOOST_AUTO(&s1, *s.s1s[p]);
@@ -422,7 +520,6 @@ void bi::MarginalSIR<B,F,A,R>::move(Random& rng, const ScheduleIterator first,
     while (!complete) {
       j = p % s.size();
       BOOST_AUTO(&s1, *s.s1s[j]);
-      BOOST_AUTO(&out1, *s.out1s[j]);
       BOOST_AUTO(&s2, s.s2);
       BOOST_AUTO(&out2, s.out2);
 
@@ -464,7 +561,7 @@ void bi::MarginalSIR<B,F,A,R>::move(Random& rng, const ScheduleIterator first,
             filter.samplePath(rng, s2, out2);
   #endif
             s1.swap(s2);
-            out1.swap(out2);
+            s.swapOutput(j, out2);
             ++naccept;
           }
           ++ntotal;
@@ -489,6 +586,71 @@ void bi::MarginalSIR<B,F,A,R>::move(Random& rng, const ScheduleIterator first,
   }
 }
 
+template<class B, class F, class A, class R>
+template<class S1>
+void bi::MarginalSIR<B,F,A,R>::exchange(Random& rng,
+    const ScheduleIterator first, const ScheduleIterator iter, S1& s) {
+  int naccept = lastAccept, ntotal = lastTotal;
+#ifdef ENABLE_MPI
+  /* all processes must exchange together, to keep their states the same
+   * size for DistributedResampler */
+  boost::mpi::communicator world;
+  naccept = boost::mpi::all_reduce(world, lastAccept, std::plus<int>());
+  ntotal = boost::mpi::all_reduce(world, lastTotal, std::plus<int>());
+#endif
+
+  if (exchangeRate > 0.0 && ntotal > 0
+      && double(naccept) / ntotal < exchangeRate) {
+    const int Px = bi::roundup(2 * s.s2.size());
+    double lW1, lW2;
+
+    /* marginal likelihood before, the exchange reweights particles but
+     * should not change the estimate */
+    resam.reduce(s.logWeights(), &lW1);
+
+    s.own();
+    s.s2.resizeMax(Px, false);
+    s.s2.setRange(0, Px);
+    for (int p = 0; p < s.size(); ++p) {
+      BOOST_AUTO(&s1, *s.s1s[p]);
+      BOOST_AUTO(&s2, s.s2);
+      BOOST_AUTO(&out2, s.out2);
+
+      try {
+        filter.replicate(rng, *first, s1, s2, out2);
+        filter.filter(rng, first, iter + 1, s2, out2);
+      } catch (CholeskyException e) {
+        s2.logLikelihood = -BI_INF;
+      } catch (ParticleFilterDegeneratedException e) {
+        s2.logLikelihood = -BI_INF;
+      }
+      if (bi::is_finite(s1.logLikelihood)) {
+        s.logWeights()(p) += s2.logLikelihood - s1.logLikelihood;
+      }
+
+      /* the replaced state becomes the next to be filtered */
+      s1.resizeMax(Px, false);
+      s1.setRange(0, Px);
+      s1.swap(s2);
+      s.swapOutput(p, out2);
+    }
+
+    resam.reduce(s.logWeights(), &lW2);
+    s.logLikelihood += lW2 - lW1;
+  }
+}
+
+template<class B, class F, class A, class R>
+template<class S1>
+void bi::MarginalSIR<B,F,A,R>::checkpoint(Random& rng,
+    const ScheduleIterator first, const ScheduleIterator iter,
+    const S1& s) {
+  if (checkpointer != NULL && checkpointer->isDue(iter->indexObs())) {
+    position = iter - first;
+    checkpointer->write(*this, rng, s);
+  }
+}
+
 template<class B, class F, class A, class R>
 template<class S1, class IO1>
 void bi::MarginalSIR<B,F,A,R>::outputT(const S1& s, IO1& out) {
@@ -503,6 +665,7 @@ void bi::MarginalSIR<B,F,A,R>::report0(const ScheduleElement now, S1& s) {
     std::cerr << std::fixed << std::setprecision(3);
     std::cerr << now.indexOutput() << ":\ttime " << now.getTime();
     std::cerr << "\tESS " << s.ess;
+    std::cerr << "\tlogZ " << s.logLikelihood;
   }
 }
 
@@ -526,6 +689,9 @@ void bi::MarginalSIR<B,F,A,R>::reportT(const ScheduleElement now, S1& s) {
       std::cerr << "\taccepts " << lastAccept;
       std::cerr << "\trate " << (double(lastAccept) / lastTotal);
     }
+    if (exchangeRate > 0.0) {
+      std::cerr << "\tPx " << s.s2.size();
+    }
     std::cerr << std::endl;
   }
 }
@@ -533,11 +699,15 @@ void bi::MarginalSIR<B,F,A,R>::reportT(const ScheduleElement now, S1& s) {
 template<class B, class F, class A, class R>
 template<class S1>
 void bi::MarginalSIR<B,F,A,R>::term(Random& rng, S1& s) {
+  s.own();
   for (int p = 0; p < s.size(); ++p) {
     BOOST_AUTO(&s1, *s.s1s[p]);
     BOOST_AUTO(&out1, *s.out1s[p]);
     filter.samplePath(rng, s1, out1);
   }
+  if (checkpointer != NULL) {
+    checkpointer->wait();
+  }
 }
 
 template<class B, class F, class A, class R>
@@ -555,4 +725,23 @@ void bi::MarginalSIR<B,F,A,R>::profile(const Step step) {
 #endif
 }
 
+template<class B, class F, class A, class R>
+template<class Archive>
+void bi::MarginalSIR<B,F,A,R>::save(Archive& ar,
+    const unsigned version) const {
+  ar & lastAccept;
+  ar & lastTotal;
+  ar & position;
+  ar & adapter;
+}
+
+template<class B, class F, class A, class R>
+template<class Archive>
+void bi::MarginalSIR<B,F,A,R>::load(Archive& ar, const unsigned version) {
+  ar & lastAccept;
+  ar & lastTotal;
+  ar & position;
+  ar & adapter;
+}
+
 #endif
@@ -10,6 +10,10 @@
 
 #include "../state/Schedule.hpp"
 #include "../cache/SMCCache.hpp"
+#include "../math/vector.hpp"
+#include "../math/matrix.hpp"
+
+#include <vector>
 
 namespace bi {
 /**
@@ -21,6 +25,15 @@ namespace bi {
  * @tparam F Filter type.
  * @tparam A Adapter type.
  * @tparam S Stopper type.
+ *
+ * Proposals may be drawn in batches, given one state per proposal in the
+ * batch. The proposals of a batch are independent given the adapter, and
+ * are filtered in parallel, one per thread. They are then added, in order,
+ * to the weighted samples to which the adapter is adapted, and output. The
+ * filter is shared between threads, as for MultiStartOptimiser: the first
+ * proposal is filtered serially, after which the input and observation
+ * caches of the filter are full, and its subsequent use must be safe from
+ * multiple threads. This is the case for all filters but AdaptivePF.
  */
 template<class B, class F, class A, class S>
 class MarginalSIS {
@@ -47,6 +60,26 @@ public:
   template<class S1, class IO1, class IO2>
   void sample(Random& rng, const ScheduleIterator first,
       const ScheduleIterator last, S1& s, const int C, IO1& out, IO2& inInit);
+
+  /**
+   * Sample, in batches.
+   *
+   * @tparam S1 State type.
+   * @tparam IO1 Output type.
+   * @tparam IO2 Input type.
+   *
+   * @param[in,out] rng Random number generator.
+   * @param first Start of time schedule.
+   * @param last End of time schedule.
+   * @param[in,out] ss States, one per proposal in a batch.
+   * @param C Number of samples to draw.
+   * @param out Output buffer.
+   * @param inInit Initialisation file.
+   */
+  template<class S1, class IO1, class IO2>
+  void sample(Random& rng, const ScheduleIterator first,
+      const ScheduleIterator last, std::vector<S1*>& ss, const int C,
+      IO1& out, IO2& inInit);
   //@}
 
   /**
@@ -68,6 +101,27 @@ public:
   void propose(Random& rng, const ScheduleIterator first,
       const ScheduleIterator last, S1& s, IO1& inInit);
 
+  /**
+   * Propose a batch of new parameter samples, and adapt the proposal to
+   * them and all previous samples.
+   *
+   * @tparam S1 State type.
+   * @tparam IO1 Input type.
+   *
+   * @param[in,out] rng Random number generator.
+   * @param first Start of time schedule.
+   * @param last End of time schedule.
+   * @param[in,out] ss States.
+   * @param n Number of proposals, at most the number of states.
+   * @param fill Propose serially first, to fill the input and observation
+   * caches of the filter?
+   * @param inInit Initialisation file.
+   */
+  template<class S1, class IO1>
+  void proposeBatch(Random& rng, const ScheduleIterator first,
+      const ScheduleIterator last, std::vector<S1*>& ss, const int n,
+      const bool fill, IO1& inInit);
+
   /**
    * Output.
    *
@@ -102,12 +156,38 @@ private:
    * Stopper.
    */
   S& stopper;
+
+  /**
+   * Parameters of all samples so far. Rows index samples, columns index
+   * parameters.
+   */
+  host_matrix<real> X;
+
+  /**
+   * Log-weights of all samples so far.
+   */
+  host_vector<real> lws;
+
+  /**
+   * Number of samples so far.
+   */
+  int nsamples;
+
+  /**
+   * Has the adapter been adapted?
+   */
+  bool adapted;
 };
 }
 
+#include "../math/function.hpp"
+#include "../math/view.hpp"
+#include "../cuda/cuda.hpp"
+
 template<class B, class F, class A, class S>
 bi::MarginalSIS<B,F,A,S>::MarginalSIS(B& m, F& filter, A& adapter, S& stopper) :
-    m(m), filter(filter), adapter(adapter), stopper(stopper) {
+    m(m), filter(filter), adapter(adapter), stopper(stopper), nsamples(0),
+    adapted(false) {
   //
 }
 
@@ -116,21 +196,41 @@ template<class S1, class IO1, class IO2>
 void bi::MarginalSIS<B,F,A,S>::sample(Random& rng,
     const ScheduleIterator first, const ScheduleIterator last, S1& s,
     const int C, IO1& out, IO2& inInit) {
+  std::vector<S1*> ss(1, &s);
+  sample(rng, first, last, ss, C, out, inInit);
+}
+
+template<class B, class F, class A, class S>
+template<class S1, class IO1, class IO2>
+void bi::MarginalSIS<B,F,A,S>::sample(Random& rng,
+    const ScheduleIterator first, const ScheduleIterator last,
+    std::vector<S1*>& ss, const int C, IO1& out, IO2& inInit) {
+  /* pre-condition */
+  BI_ASSERT(ss.size() > 0);
+
+  const int nbatch = ss.size();
   ScheduleIterator iter = first;
-  int k;
+  bool fill = true;
+  int c, i, k, n;
   while (iter != last) {
     std::cerr << iter->indexOutput() << ":\ttime " << iter->getTime() << std::endl;
     k = iter->indexObs();
-    for (int c = 0; c < C; ++c) {
-      propose(rng, first, last, s, inInit);
+    for (c = 0; c < C; c += n) {
+      n = bi::min(nbatch, C - c);
+      proposeBatch(rng, first, last, ss, n, fill, inInit);
+      fill = false;
     }
     do {
       ++iter;
     } while (iter->indexObs() == k);
   }
-  for (int c = 0; c < C; ++c) {
-    propose(rng, first, last, s, inInit);
-    output(c, s, out);
+  for (c = 0; c < C; c += n) {
+    n = bi::min(nbatch, C - c);
+    proposeBatch(rng, first, last, ss, n, fill, inInit);
+    fill = false;
+    for (i = 0; i < n; ++i) {
+      output(c + i, *ss[i], out);
+    }
   }
 }
 
@@ -138,9 +238,11 @@ template<class B, class F, class A, class S>
 template<class S1, class IO1>
 void bi::MarginalSIS<B,F,A,S>::propose(Random& rng,
     const ScheduleIterator first, const ScheduleIterator last, S1& s, IO1& inInit) {
-  if (adapter.ready()) {
+  if (adapted) {
     filter.propose(rng, *first, s.s1, s.s2, s.out, adapter);
   } else {
+    /* may read from the initialisation file */
+    #pragma omp critical(MarginalSIS)
     filter.init(rng, *first, s.s2, s.out, inInit);
   }
   if (bi::is_finite(s.s2.logPrior)) {
@@ -148,7 +250,42 @@ void bi::MarginalSIS<B,F,A,S>::propose(Random& rng,
     filter.samplePath(rng, s.s2, s.out);
     std::swap(s.s1, s.s2);
   }
-  adapter.add(s.s1);
+}
+
+template<class B, class F, class A, class S>
+template<class S1, class IO1>
+void bi::MarginalSIS<B,F,A,S>::proposeBatch(Random& rng,
+    const ScheduleIterator first, const ScheduleIterator last,
+    std::vector<S1*>& ss, const int n, const bool fill, IO1& inInit) {
+  /* pre-condition */
+  BI_ASSERT(n <= int(ss.size()));
+
+  int i, start = 0;
+  if (fill) {
+    propose(rng, first, last, *ss[0], inInit);
+    start = 1;
+  }
+  #pragma omp parallel for schedule(dynamic)
+  for (i = start; i < n; ++i) {
+    propose(rng, first, last, *ss[i], inInit);
+  }
+
+  /* add samples, doubling storage as necessary */
+  const int NP = ss[0]->s1.get(P_VAR).size2();
+  if (nsamples + n > int(X.size1())) {
+    const int N = bi::max(nsamples + n, 2 * int(X.size1()));
+    X.resize(N, NP, true);
+    lws.resize(N, true);
+  }
+  for (i = 0; i < n; ++i) {
+    S1& s = *ss[i];
+    row(X, nsamples) = vec(s.s1.get(P_VAR));
+    lws(nsamples) = s.s1.logPrior + s.s1.logLikelihood - s.s1.logProposal;
+    ++nsamples;
+  }
+  synchronize();
+
+  adapted = adapter.adapt(rows(X, 0, nsamples), subrange(lws, 0, nsamples));
 }
 
 template<class B, class F, class A, class S>
@@ -9,6 +9,7 @@
 #define BI_SAMPLER_SAMPLERFACTORY_HPP
 
 #include "MarginalMH.hpp"
+#include "MarginalPT.hpp"
 #include "MarginalSIR.hpp"
 #include "MarginalSIS.hpp"
 
@@ -25,9 +26,19 @@ public:
   /**
    * Create marginal Metropolis--Hastings sampler.
    */
-  template<class B, class F>
-  static boost::shared_ptr<MarginalMH<B,F> > createMarginalMH(B& m,
-      F& filter);
+  template<class B, class F, class A>
+  static boost::shared_ptr<MarginalMH<B,F,A> > createMarginalMH(B& m,
+      F& filter, A& adapter, const bool adaptive = false,
+      Checkpointer* checkpointer = NULL);
+
+  /**
+   * Create marginal Metropolis--Hastings sampler with parallel tempering.
+   */
+  template<class B, class F, class A>
+  static boost::shared_ptr<MarginalPT<B,F,A> > createMarginalPT(B& m,
+      F& filter, A& adapter, const bool adaptive = false,
+      const int ntemps = 4, const double maxTemp = 10.0,
+      const int swapInterval = 1);
 
   /**
    * Create marginal sequential importance resampling sampler.
@@ -35,7 +46,8 @@ public:
   template<class B, class F, class A, class R>
   static boost::shared_ptr<MarginalSIR<B,F,A,R> > createMarginalSIR(B& m,
       F& mmh, A& adapter, R& resam, const int nmoves = 1,
-      const double tmoves = 0.0);
+      const double tmoves = 0.0, const double exchangeRate = 0.0,
+      Checkpointer* checkpointer = NULL);
 
   /**
    * Create marginal sequential rejection sampler.
@@ -46,19 +58,31 @@ public:
 };
 }
 
-template<class B, class F>
-boost::shared_ptr<bi::MarginalMH<B,F> > bi::SamplerFactory::createMarginalMH(
-    B& m, F& filter) {
-  return boost::shared_ptr < MarginalMH<B,F>
-      > (new MarginalMH<B,F>(m, filter));
+template<class B, class F, class A>
+boost::shared_ptr<bi::MarginalMH<B,F,A> > bi::SamplerFactory::createMarginalMH(
+    B& m, F& filter, A& adapter, const bool adaptive,
+    Checkpointer* checkpointer) {
+  return boost::shared_ptr < MarginalMH<B,F,A>
+      > (new MarginalMH<B,F,A>(m, filter, adapter, adaptive, checkpointer));
+}
+
+template<class B, class F, class A>
+boost::shared_ptr<bi::MarginalPT<B,F,A> > bi::SamplerFactory::createMarginalPT(
+    B& m, F& filter, A& adapter, const bool adaptive, const int ntemps,
+    const double maxTemp, const int swapInterval) {
+  return boost::shared_ptr < MarginalPT<B,F,A>
+      > (new MarginalPT<B,F,A>(m, filter, adapter, adaptive, ntemps,
+          maxTemp, swapInterval));
 }
 
 template<class B, class F, class A, class R>
 boost::shared_ptr<bi::MarginalSIR<B,F,A,R> > bi::SamplerFactory::createMarginalSIR(
     B& m, F& mmh, A& adapter, R& resam, const int nmoves,
-    const double tmoves) {
+    const double tmoves, const double exchangeRate,
+    Checkpointer* checkpointer) {
   return boost::shared_ptr < MarginalSIR<B,F,A,R>
-      > (new MarginalSIR<B,F,A,R>(m, mmh, adapter, resam, nmoves, tmoves));
+      > (new MarginalSIR<B,F,A,R>(m, mmh, adapter, resam, nmoves, tmoves,
+          exchangeRate, checkpointer));
 }
 
 template<class B, class F, class A, class S>
@@ -82,6 +82,22 @@ public:
   void init(Random& rng, const ScheduleElement now, S1& s, IO1& out,
       IO2& inInit);
 
+  /**
+   * Initialise state variables given parameters, overwriting the sampled
+   * values with any given in the initialisation file.
+   *
+   * @tparam S1 State type.
+   * @tparam IO2 Input type.
+   *
+   * @param[in,out] rng Random number generator.
+   * @param now Current step in time schedule.
+   * @param[in,out] s State.
+   * @param inInit Initialisation file.
+   */
+  template<class S1, class IO2>
+  void initStates(Random& rng, const ScheduleElement now, S1& s,
+      IO2& inInit);
+
   /**
    * Propose new state from existing state.
    *
@@ -118,6 +134,27 @@ public:
   void propose(Random& rng, const ScheduleElement now, S1& s1, S2& s2,
       IO1& out, A& adapter);
 
+  /**
+   * Initialise new state with the same parameters as an existing state.
+   *
+   * @tparam S1 State type.
+   * @tparam S2 State type.
+   * @tparam IO1 Output type.
+   *
+   * @param[in,out] rng Random number generator.
+   * @param now Current step in time schedule.
+   * @param s1 Existing state.
+   * @param[out] s2 New state.
+   * @param out Output file.
+   *
+   * The prior and proposal log-densities of @p s1 are carried over, while
+   * the state variables of @p s2 are drawn afresh, so that @p s2 may have a
+   * different number of trajectories to @p s1.
+   */
+  template<class S1, class S2, class IO1>
+  void replicate(Random& rng, const ScheduleElement now, const S1& s1,
+      S2& s2, IO1& out);
+
   /**
    * Advance model forward to time of next output, and output.
    *
@@ -297,8 +334,19 @@ void bi::Simulator<B,F,O>::init(Random& rng, const ScheduleElement now, S1& s,
   }
 
   /* state variable initial values */
+  initStates(rng, now, s, inInit);
+
+  out.clear();
+}
+
+template<class B, class F, class O>
+template<class S1, class IO2>
+void bi::Simulator<B,F,O>::initStates(Random& rng, const ScheduleElement now,
+    S1& s, IO2& inInit) {
   m.initialSamples(rng, s);
   if (!equals<IO2,InputNullBuffer>::value) {  // if there's actually a buffer...
+    std::vector<real> ts;
+    inInit.readTimes(ts);
     inInit.read0(D_VAR, s.get(D_VAR));
     inInit.read0(R_VAR, s.get(R_VAR));
 
@@ -313,8 +361,6 @@ void bi::Simulator<B,F,O>::init(Random& rng, const ScheduleElement now, S1& s,
     s.get(RY_VAR) = s.get(R_VAR);
     m.initialSimulates(s);
   }
-
-  out.clear();
 }
 
 template<class B, class F, class O>
@@ -394,6 +440,38 @@ void bi::Simulator<B,F,O>::propose(Random& rng, const ScheduleElement now,
   out.clear();
 }
 
+template<class B, class F, class O>
+template<class S1, class S2, class IO1>
+void bi::Simulator<B,F,O>::replicate(Random& rng, const ScheduleElement now,
+    const S1& s1, S2& s2, IO1& out) {
+  s2.clear();
+  s2.setTime(now.getTime());
+
+  /* static inputs */
+  in.update0(s2);
+
+  /* parameters */
+  s2.get(P_VAR) = s1.get(P_VAR);
+  s2.get(PY_VAR) = s2.get(P_VAR);
+  s2.logPrior = s1.logPrior;
+  s2.logProposal = s1.logProposal;
+
+  /* dynamic inputs */
+  if (now.hasInput()) {
+    in.update(now.indexInput(), s2);
+  }
+
+  /* observations */
+  if (now.hasObs()) {
+    obs.update(now.indexObs(), s2);
+  }
+
+  /* initial values */
+  m.initialSamples(rng, s2);
+
+  out.clear();
+}
+
 template<class B, class F, class O>
 template<class S1, class IO1>
 void bi::Simulator<B,F,O>::step(Random& rng, ScheduleIterator& iter,
@@ -74,6 +74,13 @@ public:
   template<class V1>
   void gather(const ScheduleElement now, const V1 as);
 
+  /*
+   * Scratch state in which lookaheads are performed, so that the particles
+   * need not be saved and restored around them. Sized on first use to the
+   * active range, and not copied or serialized with the state.
+   */
+  State<B,L> lookaheadState;
+
 private:
   /**
    * Proposal log-weights.
@@ -102,13 +109,13 @@ private:
 
 template<class B, bi::Location L>
 bi::AuxiliaryPFState<B,L>::AuxiliaryPFState(const int P, const int Y, const int T) :
-    BootstrapPFState<B,L>(P, Y, T), qlws(P) {
+    BootstrapPFState<B,L>(P, Y, T), lookaheadState(0), qlws(P) {
   //
 }
 
 template<class B, bi::Location L>
 bi::AuxiliaryPFState<B,L>::AuxiliaryPFState(const AuxiliaryPFState<B,L>& o) :
-    BootstrapPFState<B,L>(o), qlws(o.qlws) {
+    BootstrapPFState<B,L>(o), lookaheadState(0), qlws(o.qlws) {
   //
 }
 
@@ -130,6 +137,7 @@ void bi::AuxiliaryPFState<B,L>::clear() {
 template<class B, bi::Location L>
 void bi::AuxiliaryPFState<B,L>::swap(AuxiliaryPFState<B,L>& o) {
   BootstrapPFState<B,L>::swap(o);
+  lookaheadState.swap(o.lookaheadState);
   qlws.swap(o.qlws);
 }
 
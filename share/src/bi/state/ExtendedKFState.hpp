@@ -9,6 +9,7 @@
 #define BI_STATE_EXTENDEDKFSTATE_HPP
 
 #include "FilterState.hpp"
+#include "../cache/CacheObject.hpp"
 
 namespace bi {
 /**
@@ -67,6 +68,27 @@ public:
    */
   typename State<B,L>::matrix_type U1, U2, C;
 
+  /*
+   * Projections from observation masks to observed variables, cached by
+   * observation index. These differ in size between pages, so are not
+   * copied with the state, but rebuilt on first use.
+   */
+  CacheObject<typename State<B,L>::int_vector_type> maps;
+
+  /*
+   * Workspace for correction, sized for the largest mask so far. Columns
+   * and leading blocks of these are used for smaller masks.
+   */
+  typename State<B,L>::matrix_type C3, U3, Sigma3, R3;
+  typename State<B,L>::vector_type y3, z3, mu3;
+
+  /**
+   * Ensure that workspace for correction is large enough.
+   *
+   * @param W Mask size.
+   */
+  void reserve(const int W);
+
 private:
   /**
    * Number of dynamic variables.
@@ -114,6 +136,7 @@ bi::ExtendedKFState<B,L>& bi::ExtendedKFState<B,L>::operator=(
   U1 = o.U1;
   U2 = o.U2;
   C = o.C;
+  maps.empty();
 
   return *this;
 }
@@ -142,6 +165,27 @@ void bi::ExtendedKFState<B,L>::swap(ExtendedKFState<B,L>& o) {
   U1.swap(o.U1);
   U2.swap(o.U2);
   C.swap(o.C);
+  maps.swap(o.maps);
+  C3.swap(o.C3);
+  U3.swap(o.U3);
+  Sigma3.swap(o.Sigma3);
+  R3.swap(o.R3);
+  y3.swap(o.y3);
+  z3.swap(o.z3);
+  mu3.swap(o.mu3);
+}
+
+template<class B, bi::Location L>
+void bi::ExtendedKFState<B,L>::reserve(const int W) {
+  if (U3.size1() < W) {
+    C3.resize(M, W);
+    U3.resize(W, W);
+    Sigma3.resize(W, W);
+    R3.resize(W, W);
+    y3.resize(W);
+    z3.resize(W);
+    mu3.resize(W);
+  }
 }
 
 template<class B, bi::Location L>
@@ -11,6 +11,8 @@
 #include "ScheduleElement.hpp"
 
 #include <vector>
+#include <algorithm>
+#include <new>
 
 namespace bi {
 /**
@@ -22,6 +24,20 @@ namespace bi {
  * @tparam L Location.
  * @tparam S1 Filter state type.
  * @tparam IO1 Output type.
+ *
+ * The states and output buffers of all \f$\theta\f$-particles are
+ * constructed in two contiguous blocks, allocated once on construction, and
+ * never reallocated. #s1s and #out1s point into these blocks, so that
+ * reordering particles, as in Resampler::shuffle(), swaps pointers only,
+ * while duplicating particles, as in #gather, assigns into the existing
+ * storage of the particle being replaced.
+ *
+ * Output buffers of duplicated particles, which hold the full history of
+ * their \f$x\f$-particles, are copied on write: after #gather, each
+ * duplicate shares the buffer of its ancestor, until either #own is called
+ * to give it a private copy before it is written, or #swapOutput replaces
+ * it outright, as when a move is accepted, in which case no copy is ever
+ * made.
  */
 template<class B, Location L, class S1, class IO1>
 class MarginalSIRState {
@@ -64,6 +80,11 @@ public:
    */
   MarginalSIRState(const MarginalSIRState<B,L,S1,IO1>& o);
 
+  /**
+   * Destructor.
+   */
+  ~MarginalSIRState();
+
   /**
    * Deep assignment operator.
    */
@@ -111,10 +132,36 @@ public:
 
   /**
    * Gather particles.
+   *
+   * @param now Current step in time schedule.
+   * @param as Ancestors. These must be permuted so that each ancestor is
+   * its own offspring, as with Resampler::ancestorsPermute().
+   *
+   * States are copied immediately, output buffers are shared until #own or
+   * #swapOutput is called.
    */
   template<class V1>
   void gather(const ScheduleElement now, const V1 as);
 
+  /**
+   * Give every particle a private copy of its output buffer, where it
+   * still shares that of its ancestor. Must be called before output
+   * buffers are written, other than through #swapOutput.
+   */
+  void own();
+
+  /**
+   * Replace the output buffer of a particle by swapping it with another.
+   *
+   * @param p Index of particle.
+   * @param[in,out] out Output buffer.
+   *
+   * If the particle shares the output buffer of its ancestor, the sharing
+   * simply ends. If other particles share the output buffer of this one,
+   * its contents are first passed on to them.
+   */
+  void swapOutput(const int p, IO1& out);
+
   /**
    * \f$\theta\f$-particles.
    */
@@ -156,6 +203,32 @@ public:
   long clock;
 
 private:
+  /**
+   * Allocate storage for \f$\theta\f$-particles.
+   */
+  void allocate();
+
+  /**
+   * Storage for states of \f$\theta\f$-particles.
+   */
+  S1* s1Pool;
+
+  /**
+   * Storage for output buffers of \f$\theta\f$-particles.
+   */
+  IO1* out1Pool;
+
+  /**
+   * For each output buffer in #out1Pool, the index in #out1Pool of the
+   * buffer it shares, or -1 if it is not shared.
+   */
+  std::vector<int> sources;
+
+  /**
+   * Output buffer of a particle, or of its ancestor if shared.
+   */
+  const IO1& output(const int p) const;
+
   /**
    * Log-weights.
    */
@@ -200,11 +273,12 @@ template<class B, bi::Location L, class S1, class IO1>
 bi::MarginalSIRState<B,L,S1,IO1>::MarginalSIRState(B& m, const int Ptheta,
     const int Px, const int Y, const int T) :
     s1s(Ptheta), out1s(Ptheta), s2(Px, Y, T), out2(m, Px, T), logIncrements(Y), logLikelihood(
-        0.0), ess(0.0), lws(Ptheta), as(Ptheta), ptheta(0), Ptheta(
+        0.0), ess(0.0), sources(Ptheta, -1), lws(Ptheta), as(Ptheta), ptheta(0), Ptheta(
         Ptheta) {
+  allocate();
   for (int p = 0; p < size(); ++p) {
-    s1s[p] = new S1(Px, Y, T);
-    out1s[p] = new IO1(m, Px, T);
+    s1s[p] = new (s1Pool + p) S1(Px, Y, T);
+    out1s[p] = new (out1Pool + p) IO1(m, Px, T);
   }
 }
 
@@ -212,12 +286,25 @@ template<class B, bi::Location L, class S1, class IO1>
 bi::MarginalSIRState<B,L,S1,IO1>::MarginalSIRState(
     const MarginalSIRState<B,L,S1,IO1>& o) :
     s1s(o.s1s.size()), out1s(o.out1s.size()), s2(o.s2), out2(o.out2), logIncrements(o.logIncrements), logLikelihood(
-        o.logLikelihood), ess(0.0), lws(o.lws), as(
+        o.logLikelihood), ess(0.0), sources(o.sources.size(), -1), lws(o.lws), as(
         o.as), ptheta(o.ptheta), Ptheta(o.Ptheta) {
+  allocate();
   for (int p = 0; p < size(); ++p) {
-    s1s[p] = new S1(*o.s1s[p]);
-    out1s[p] = new IO1(*o.out1s[p]);
+    s1s[p] = new (s1Pool + p) S1(*o.s1s[p]);
+    out1s[p] = new (out1Pool + p) IO1(o.output(p));
+  }
+}
+
+template<class B, bi::Location L, class S1, class IO1>
+bi::MarginalSIRState<B,L,S1,IO1>::~MarginalSIRState() {
+  /* particles are destroyed in storage order, as #s1s and #out1s may have
+   * been reordered */
+  for (int p = 0; p < int(s1s.size()); ++p) {
+    s1Pool[p].~S1();
+    out1Pool[p].~IO1();
   }
+  ::operator delete(s1Pool);
+  ::operator delete(out1Pool);
 }
 
 template<class B, bi::Location L, class S1, class IO1>
@@ -226,9 +313,10 @@ bi::MarginalSIRState<B,L,S1,IO1>& bi::MarginalSIRState<B,L,S1,IO1>::operator=(
   /* pre-condition */
   BI_ASSERT(o.size() == size());
 
+  own();
   for (int p = 0; p < size(); ++p) {
     *s1s[p] = *o.s1s[p];
-    *out1s[p] = *o.out1s[p];
+    *out1s[p] = o.output(p);
   }
   s2 = o.s2;
   out2 = o.out2;
@@ -245,6 +333,7 @@ bi::MarginalSIRState<B,L,S1,IO1>& bi::MarginalSIRState<B,L,S1,IO1>::operator=(
 
 template<class B, bi::Location L, class S1, class IO1>
 void bi::MarginalSIRState<B,L,S1,IO1>::clear() {
+  std::fill(sources.begin(), sources.end(), -1);
   for (int p = 0; p < size(); ++p) {
     s1s[p]->clear();
     out1s[p]->clear();
@@ -262,6 +351,9 @@ template<class B, bi::Location L, class S1, class IO1>
 void bi::MarginalSIRState<B,L,S1,IO1>::swap(MarginalSIRState<B,L,S1,IO1>& o) {
   std::swap(s1s, o.s1s);
   std::swap(out1s, o.out1s);
+  std::swap(s1Pool, o.s1Pool);
+  std::swap(out1Pool, o.out1Pool);
+  std::swap(sources, o.sources);
   s2.swap(o.s2);
   out2.swap(o.out2);
   logIncrements.swap(o.logIncrements);
@@ -271,6 +363,13 @@ void bi::MarginalSIRState<B,L,S1,IO1>::swap(MarginalSIRState<B,L,S1,IO1>& o) {
   as.swap(o.as);
 }
 
+template<class B, bi::Location L, class S1, class IO1>
+void bi::MarginalSIRState<B,L,S1,IO1>::allocate() {
+  const int P = s1s.size();
+  s1Pool = static_cast<S1*>(::operator new(P * sizeof(S1)));
+  out1Pool = static_cast<IO1*>(::operator new(P * sizeof(IO1)));
+}
+
 template<class B, bi::Location L, class S1, class IO1>
 int bi::MarginalSIRState<B,L,S1,IO1>::size() const {
   return Ptheta;
@@ -318,6 +417,9 @@ void bi::MarginalSIRState<B,L,S1,IO1>::gather(const ScheduleElement now,
     bi::gather(as, ancestors(), ancestors());
   }
 
+  /* sharing is only to ancestors that are not themselves shared */
+  own();
+
   // don't use OpenMP for this, causing segfault with Intel compiler, and
   // with CUDA, possibly due to different CUDA contexts with different
   // threads playing with the resize and assignment
@@ -325,18 +427,58 @@ void bi::MarginalSIRState<B,L,S1,IO1>::gather(const ScheduleElement now,
     int a = as(i);
     if (i != a) {
       *s1s[i] = *s1s[a];
-      *out1s[i] = *out1s[a];
+      sources[out1s[i] - out1Pool] = out1s[a] - out1Pool;
+    }
+  }
+}
+
+template<class B, bi::Location L, class S1, class IO1>
+void bi::MarginalSIRState<B,L,S1,IO1>::own() {
+  for (int k = 0; k < int(sources.size()); ++k) {
+    if (sources[k] >= 0) {
+      out1Pool[k] = out1Pool[sources[k]];
+      sources[k] = -1;
     }
   }
 }
 
+template<class B, bi::Location L, class S1, class IO1>
+void bi::MarginalSIRState<B,L,S1,IO1>::swapOutput(const int p, IO1& out) {
+  const int k = out1s[p] - out1Pool;
+  if (sources[k] >= 0) {
+    sources[k] = -1;
+  } else {
+    /* the first particle sharing this buffer takes over its contents, and
+     * the rest share with that particle instead */
+    int heir = -1;
+    for (int q = 0; q < int(sources.size()); ++q) {
+      if (sources[q] == k) {
+        if (heir < 0) {
+          heir = q;
+          sources[q] = -1;
+          out1Pool[q].swap(out1Pool[k]);
+        } else {
+          sources[q] = heir;
+        }
+      }
+    }
+  }
+  out1s[p]->swap(out);
+}
+
+template<class B, bi::Location L, class S1, class IO1>
+const IO1& bi::MarginalSIRState<B,L,S1,IO1>::output(const int p) const {
+  const int k = out1s[p] - out1Pool;
+  return (sources[k] >= 0) ? out1Pool[sources[k]] : *out1s[p];
+}
+
 template<class B, bi::Location L, class S1, class IO1>
 template<class Archive>
 void bi::MarginalSIRState<B,L,S1,IO1>::save(Archive& ar,
     const unsigned version) const {
   for (int p = 0; p < size(); ++p) {
     ar & *s1s[p];
-    ar & *out1s[p];
+    ar & output(p);
   }
   ar & s2;
   ar & out2;
@@ -353,6 +495,7 @@ template<class B, bi::Location L, class S1, class IO1>
 template<class Archive>
 void bi::MarginalSIRState<B,L,S1,IO1>::load(Archive& ar,
     const unsigned version) {
+  std::fill(sources.begin(), sources.end(), -1);
   for (int p = 0; p < size(); ++p) {
     ar & *s1s[p];
     ar & *out1s[p];
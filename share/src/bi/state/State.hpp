@@ -125,6 +125,9 @@ public:
 
   /**
    * Swap.
+   *
+   * The active ranges of particles are swapped along with the buffers that
+   * they index.
    */
   void swap(State<B,L>& o);
 
@@ -521,6 +524,8 @@ void bi::State<B,L>::swap(State<B,L>& o) {
   std::swap(logPrior, o.logPrior);
   std::swap(logProposal, o.logProposal);
   std::swap(clock, o.clock);
+  std::swap(p, o.p);
+  std::swap(P, o.P);
   Xdn.swap(o.Xdn);
   Kdn.swap(o.Kdn);
   for (int i = 0; i < NB; ++i) {
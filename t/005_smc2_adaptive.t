@@ -0,0 +1,53 @@
+use Test::More tests => 4;
+
+use File::Temp qw(tempdir);
+
+my $dir = tempdir(CLEANUP => 1);
+my $model = "$dir/Adaptive.bi";
+
+open(MODEL, ">$model") || die("could not write $model\n");
+print MODEL <<'END';
+model Adaptive {
+  param theta;
+  noise w;
+  state x;
+  obs y;
+
+  sub parameter {
+    theta ~ uniform(0.0, 1.0);
+  }
+
+  sub initial {
+    x ~ gaussian();
+  }
+
+  sub transition {
+    w ~ gaussian();
+    x <- theta*x + w;
+  }
+
+  sub observation {
+    y ~ gaussian(x, 0.5);
+  }
+}
+END
+close MODEL;
+
+my $common = "--model-file $model --end-time 20 --noutputs 20 --seed 1";
+
+is(system("script/libbi sample $common --target joint --nsamples 1 --output-file $dir/obs.nc >/dev/null 2>&1") >> 8,
+    0, 'simulate observations');
+
+# moves swap theta-particles whose adaptive filter states differ in range
+my $log = `script/libbi sample $common --target posterior --sampler smc2 --filter adaptive --nsamples 64 --nparticles 32 --nmoves 2 --stopper-threshold 64 --stopper-block 16 --obs-file $dir/obs.nc --output-file $dir/posterior.nc 2>&1 >/dev/null`;
+is($? >> 8, 0, 'SMC^2 with adaptive particle filter');
+
+# reference run with the bootstrap particle filter, for the same posterior
+my $ref = `script/libbi sample $common --target posterior --sampler smc2 --filter bootstrap --nsamples 64 --nparticles 128 --nmoves 2 --obs-file $dir/obs.nc --output-file $dir/reference.nc 2>&1 >/dev/null`;
+is($? >> 8, 0, 'SMC^2 with bootstrap particle filter');
+
+# both estimate the same log-evidence, reported on the final line
+my ($logZ) = ($log =~ /logZ (\S+)/g)[-1];
+my ($refLogZ) = ($ref =~ /logZ (\S+)/g)[-1];
+ok(defined($logZ) && defined($refLogZ) && abs($logZ - $refLogZ) < 3.0,
+    'log-evidence agrees with bootstrap particle filter');
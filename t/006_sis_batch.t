@@ -0,0 +1,49 @@
+use Test::More tests => 4;
+
+use File::Temp qw(tempdir);
+
+my $dir = tempdir(CLEANUP => 1);
+my $model = "$dir/Batch.bi";
+
+open(MODEL, ">$model") || die("could not write $model\n");
+print MODEL <<'END';
+model Batch {
+  param theta;
+  noise w;
+  state x;
+  obs y;
+
+  sub parameter {
+    theta ~ uniform(0.0, 1.0);
+  }
+
+  sub initial {
+    x ~ gaussian();
+  }
+
+  sub transition {
+    w ~ gaussian();
+    x <- theta*x + w;
+  }
+
+  sub observation {
+    y ~ gaussian(x, 0.5);
+  }
+}
+END
+close MODEL;
+
+my $common = "--model-file $model --end-time 10 --noutputs 10 --seed 1";
+
+is(system("script/libbi sample $common --target joint --nsamples 1 --output-file $dir/obs.nc >/dev/null 2>&1") >> 8,
+    0, 'simulate observations');
+
+# proposals after the first batch come from the adapted Gaussian
+is(system("script/libbi sample $common --target posterior --sampler sis --nbatch 4 --nsamples 32 --nparticles 32 --adapter-ess-rel 0.1 --obs-file $dir/obs.nc --output-file $dir/posterior.nc >/dev/null 2>&1") >> 8,
+    0, 'SIS in batches of 4');
+
+isnt(system("script/libbi sample $common --target posterior --sampler sis --nbatch 0 --obs-file $dir/obs.nc >/dev/null 2>&1") >> 8,
+    0, 'reject --nbatch 0');
+
+isnt(system("script/libbi sample $common --target posterior --sampler sis --nbatch 4 --filter adaptive --obs-file $dir/obs.nc >/dev/null 2>&1") >> 8,
+    0, 'reject --nbatch with adaptive particle filter');
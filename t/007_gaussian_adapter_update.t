@@ -0,0 +1,48 @@
+use Test::More tests => 3;
+
+use File::Temp qw(tempdir);
+
+my $dir = tempdir(CLEANUP => 1);
+my $model = "$dir/Update.bi";
+
+# theta does not enter the likelihood, so that with the Kalman filter all
+# theta-particles are reweighted by the same increment, no resampling or
+# moves occur, and the Gaussian adapter should update rather than refit
+open(MODEL, ">$model") || die("could not write $model\n");
+print MODEL <<'END';
+model Update {
+  param theta;
+  noise w;
+  state x;
+  obs y;
+
+  sub parameter {
+    theta ~ uniform(0.0, 1.0);
+  }
+
+  sub initial {
+    x ~ gaussian();
+  }
+
+  sub transition {
+    w ~ gaussian();
+    x <- 0.5*x + w;
+  }
+
+  sub observation {
+    y ~ gaussian(x, 0.5);
+  }
+}
+END
+close MODEL;
+
+my $common = "--model-file $model --end-time 10 --noutputs 10 --seed 1";
+
+is(system("script/libbi sample $common --target joint --nsamples 1 --output-file $dir/obs.nc >/dev/null 2>&1") >> 8,
+    0, 'simulate observations');
+
+my $log = `script/libbi sample $common --target posterior --sampler smc2 --filter kalman --adapter global --nsamples 32 --obs-file $dir/obs.nc --output-file $dir/posterior.nc 2>&1`;
+is($? >> 8, 0, 'SMC^2 with Gaussian adapter');
+
+my ($updates) = $log =~ /Gaussian adapter: (\d+) updates/;
+ok(defined($updates) && $updates > 0, 'adaptations update the proposal in place');